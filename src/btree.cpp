@@ -15,7 +15,6 @@
 #include "exceptions/index_scan_completed_exception.h"
 #include "exceptions/file_not_found_exception.h"
 #include "exceptions/file_exists_exception.h"
-#include "exceptions/end_of_file_exception.h"
 #include "exceptions/page_pinned_exception.h"
 
 
@@ -45,12 +44,35 @@ namespace badgerdb {
                            std::string &outIndexName,
                            BufMgr *bufMgrIn,
                            const int attrByteOffset,
-                           const Datatype attrType) {
-        // Add your code below. Please do not remove this line.
+                           const Datatype attrType)
+        : BTreeIndex(relationName, outIndexName, bufMgrIn, bufMgrIn, attrByteOffset, attrType) {
+    }
+
+    BTreeIndex::BTreeIndex(const std::string &relationName,
+                           std::string &outIndexName,
+                           BufPoolRegistry *pools,
+                           const int attrByteOffset,
+                           const Datatype attrType)
+        : BTreeIndex(relationName, outIndexName,
+                     pools->poolFor(indexName(relationName, attrByteOffset), INDEX_FILE),
+                     pools->poolFor(relationName, HEAP_FILE), attrByteOffset, attrType) {
+    }
+
+    std::string BTreeIndex::indexName(const std::string &relationName, const int attrByteOffset) {
         std::ostringstream idxStr;
         idxStr << relationName << '.' << attrByteOffset;
+        return idxStr.str();
+    }
+
+    BTreeIndex::BTreeIndex(const std::string &relationName,
+                           std::string &outIndexName,
+                           BufMgr *bufMgrIn,
+                           BufMgr *relationBufMgr,
+                           const int attrByteOffset,
+                           const Datatype attrType) {
+        // Add your code below. Please do not remove this line.
         // indexName is the name of the index file
-        outIndexName = idxStr.str();
+        outIndexName = indexName(relationName, attrByteOffset);
 
         // set private variables to the correct values
         bufMgr = bufMgrIn; // set private BufMgr instance
@@ -89,21 +111,14 @@ namespace badgerdb {
             rootIsLeaf = 1;
 
             // setting up variables needed for file scanning
-            FileScan fileScan(relationName, bufMgr);
+            FileScan fileScan(relationName, relationBufMgr);
             RecordId rid;
             std::string recordPointer;
 
-            bool readingFile = true; // keeps track of if end of file hasn't been reached
-            // inserting entries for every tuple in base relation
-            while (readingFile) {
-                try {
-                    fileScan.scanNext(rid);
-                    recordPointer = fileScan.getRecord();
-                    insertEntry((recordPointer.c_str()) + attrByteOffset, rid);
-                } catch (EndOfFileException &e) {
-                    readingFile = false;
-                    fileScan.~FileScan();
-                }
+            // inserting entries for every tuple in base relation, until the end of the file
+            while (fileScan.tryScanNext(rid)) {
+                recordPointer = fileScan.getRecord();
+                insertEntry((recordPointer.c_str()) + attrByteOffset, rid);
             }
 
         } catch (FileExistsException &e) { // file exists
@@ -203,8 +218,9 @@ namespace badgerdb {
             bufMgr->unPinPage(file, headerPageNum, false);
             IndexMetaInfo *idxMeta = new IndexMetaInfo();
             idxMeta = (IndexMetaInfo *) HeaderPage;
-            bufMgr->readPage(file, idxMeta->rootPageNo, RootPage);
-            bufMgr->unPinPage(file, idxMeta->rootPageNo, false);
+            // the root stays pinned while its child links are followed
+            PageHandle rootHandle = bufMgr->readPage(file, idxMeta->rootPageNo);
+            RootPage = rootHandle.page();
 
             bool isLeaf = false;
             RIDKeyPair<int> *pair = new RIDKeyPair<int>();
@@ -212,6 +228,7 @@ namespace badgerdb {
 
             RecordId place_rec_id;
             Page *place_page;
+            PageId place_page_num = Page::INVALID_NUMBER;
             NonLeafNodeInt *cursor = (NonLeafNodeInt *) RootPage; //get the current root page using pageID
 
             NonLeafNodeInt *parent;
@@ -221,9 +238,9 @@ namespace badgerdb {
                 parent = cursor;
 
                 for (int i = 0; i < nodeOccupancy; i++) {
-                    Page *nextPage;
-                    bufMgr->readPage(file, cursor->pageNoArray[i], nextPage);
-                    bufMgr->unPinPage(file, cursor->pageNoArray[i], false);
+                    PageId nextPageNum;
+                    PageHandle nextHandle = bufMgr->readChild(file, rootHandle, &cursor->pageNoArray[i], nextPageNum);
+                    Page *nextPage = nextHandle.page();
 
                     for (PageIterator iter = nextPage->begin();
                          iter != nextPage->end();
@@ -234,6 +251,7 @@ namespace badgerdb {
                             //go to the left side of the tree
                             place_rec_id = iter.getCurrentRecord();
                             place_page = nextPage;
+                            place_page_num = nextPageNum;
                             isLeaf = true;
                             break;
                         }
@@ -270,10 +288,13 @@ namespace badgerdb {
                 found->ridArray[i] = rid;
             } else {
                 // handle the case here the current leafe node is overfilling
+                // child links are moved below, so they must hold page numbers
+                bufMgr->unswizzle(rootHandle);
                 LeafNodeInt *newLeaf = new LeafNodeInt;
                 Page *newLeafPage;
                 PageId *nLeafPageNum;
-                bufMgr->allocPage(file, *nLeafPageNum, newLeafPage);
+                // keep the new leaf in the extent of the one it splits from
+                bufMgr->allocPage(file, *nLeafPageNum, newLeafPage, place_page_num);
                 bufMgr->unPinPage(file, *nLeafPageNum, true);
 
                 int virtualNode[leafOccupancy + 1];
@@ -357,7 +378,7 @@ namespace badgerdb {
                     // Recursive Call for
                     // insert in internal
                     insertInternal(*k,newLeaf->ridArray[sizeof(cursor->keyArray)],
-                                   parent,
+                                   parent, rootHandle,
                                    newLeaf, place_rec_id, *nLeafPageNum);
                 }
 
@@ -369,9 +390,11 @@ namespace badgerdb {
  * Helper method for insertEntry
 */
     void BTreeIndex::insertInternal(int k, RecordId x,
-                                    NonLeafNodeInt *cursor,
+                                    NonLeafNodeInt *cursor, const PageHandle &cursorHandle,
                                     void *child, RecordId cursorRID, PageId child_page_id) {
         LeafNodeInt *leaf_child = (LeafNodeInt *) child;
+        // both the shift and the split below move child links, so they must hold page numbers
+        bufMgr->unswizzle(cursorHandle);
         // If we doesn't have overflow
         if (sizeof(cursor->keyArray) < leafOccupancy) {
             int i = 0;
@@ -508,7 +531,7 @@ namespace badgerdb {
                 // Recursive Call to insert
                 // the data
                 insertInternal(k,x,
-                               cursor,
+                               cursor, cursorHandle,
                                newInternal,cursorRID,child_page_id);
             }
         }
@@ -575,7 +598,8 @@ namespace badgerdb {
 
         currentPageNum = rootPageNum;
 
-        bufMgr->readPage(file, currentPageNum, currentPageData);
+        currentPage = bufMgr->readPage(file, currentPageNum);
+        currentPageData = currentPage.page();
 
         if (!rootIsLeaf) { // traverse tree if root is not the only node
             NonLeafNodeInt *currPage = (NonLeafNodeInt *) currentPageData;
@@ -593,19 +617,18 @@ namespace badgerdb {
                     // lowValInt is greater than greatest key in node, so go to last page
                     if (currPage->keyArray[i] == 0 && lowValInt > currPage->keyArray[i]) {
                         pageFound = true;
-                        bufMgr->unPinPage(file, currentPageNum, false);
-                        currentPageNum = currPage->pageNoArray[i + 1];
-                        bufMgr->readPage(file, currentPageNum, currentPageData);
+                        currentPage = bufMgr->readChild(file, currentPage, &currPage->pageNoArray[i + 1], currentPageNum);
+                        currentPageData = currentPage.page();
                         break;
                     }
                     // lowValInt less than key, go to corresponding page
                     if (lowValInt <= currPage->keyArray[i]) {
                         pageFound = true;
-                        bufMgr->unPinPage(file, currentPageNum, false);
                         // set current page to pageNoArray index i when
-                        // lowValInt is smaller than the key to the right of it
-                        currentPageNum = currPage->pageNoArray[i];
-                        bufMgr->readPage(file, currentPageNum, currentPageData);
+                        // lowValInt is smaller than the key to the right of it.
+                        // The parent stays pinned until the child is.
+                        currentPage = bufMgr->readChild(file, currentPage, &currPage->pageNoArray[i], currentPageNum);
+                        currentPageData = currentPage.page();
                         break;
                     }
                 }
@@ -657,15 +680,17 @@ namespace badgerdb {
                 }
                 // search continues to leaf node to the right of the current one
                 if (searching) {
-                    bufMgr->unPinPage(file, currentPageNum, false);
+                    currentPage.release();
                     currentPageNum = leafPage->rightSibPageNo;
-                    bufMgr->readPage(file, currentPageNum, currentPageData);
+                    currentPage = bufMgr->readPage(file, currentPageNum);
+                    currentPageData = currentPage.page();
                 }
             }
             nextEntry = keyIndex + 1; // set nextEntry to next key in keyArray of current page
         } else { // make root current page in scan if it is a leaf
             currentPageNum = rootPageNum;
-            bufMgr->readPage(file, currentPageNum, currentPageData);
+            currentPage = bufMgr->readPage(file, currentPageNum);
+            currentPageData = currentPage.page();
             nextEntry = 0; // reset next entry, because we reach new page
         }
 
@@ -684,6 +709,16 @@ namespace badgerdb {
     void BTreeIndex::scanNext(RecordId &outRid) {
         // Add your code below. Please do not remove this line.
 
+        if (!tryScanNext(outRid)) {
+            throw IndexScanCompletedException();
+        }
+    }
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::tryScanNext
+// -----------------------------------------------------------------------------
+
+    bool BTreeIndex::tryScanNext(RecordId &outRid) {
         // if no scan has been initialized, throw error
         if (!scanExecuting) {
             throw ScanNotInitializedException();
@@ -719,11 +754,11 @@ namespace badgerdb {
                 }
                 if (usesLt) { // not in criteria if key > highValInt
                     if (highValInt <= leafPage->keyArray[keyIndex]) {
-                        throw IndexScanCompletedException();
+                        return false;
                     }
                 } else { // not in criteria if key >= highValInt
                     if (highValInt < leafPage->keyArray[keyIndex]) {
-                        throw IndexScanCompletedException();
+                        return false;
                     }
                 }
                 searching = false;
@@ -732,18 +767,25 @@ namespace badgerdb {
             nextEntry = keyIndex;
             // if we've reached final leaf node without any key matching scan criteria
             if (leafPage->rightSibPageNo == 0 && searching) {
-                throw IndexScanCompletedException();
+                return false;
             }
             // search continues to leaf node to the right of the current one
             if (searching) {
                 nextEntry = 0; // start on first index of next page
-                bufMgr->unPinPage(file, currentPageNum, false);
+                currentPage.release();
                 currentPageNum = leafPage->rightSibPageNo;
-                bufMgr->readPage(file, currentPageNum, currentPageData);
+                currentPage = bufMgr->readPage(file, currentPageNum);
+                currentPageData = currentPage.page();
+                // start reading the leaf after this one while this one is scanned
+                PageId nextLeafNum = ((LeafNodeInt *) currentPageData)->rightSibPageNo;
+                if (nextLeafNum != 0) {
+                    bufMgr->prefetch(file, nextLeafNum, 1);
+                }
             }
             outRid = leafPage->ridArray[nextEntry];
         }
 
+        return true;
     }
 
 // -----------------------------------------------------------------------------
@@ -764,7 +806,7 @@ namespace badgerdb {
         scanExecuting = false;
 
         // unpin any pinned pages
-        bufMgr->unPinPage(file, currentPageNum, false);
+        currentPage.release();
 
         // reset scan specific variables
         scanExecuting = false;
@@ -16,6 +16,7 @@
 #include "page.h"
 #include "file.h"
 #include "buffer.h"
+#include "pool_registry.h"
 
 namespace badgerdb
 {
@@ -259,6 +260,11 @@ class BTreeIndex {
    */
 	Page		*currentPageData;
 
+  /**
+   * Pin on the current page being scanned.
+   */
+	PageHandle	currentPage;
+
   /**
    * Low INTEGER value for scan.
    */
@@ -304,6 +310,19 @@ class BTreeIndex {
    */
 
 	int rootIsLeaf;
+
+  /**
+   * Returns the name of the index file for the given relation and attribute.
+   */
+	static std::string indexName(const std::string & relationName, const int attrByteOffset);
+
+  /**
+   * Constructor doing the work of the public ones.
+   *
+   * @param relationBufMgr			Buffer Manager Instance used to scan the base relation
+   */
+	BTreeIndex(const std::string & relationName, std::string & outIndexName,
+						BufMgr *bufMgrIn, BufMgr *relationBufMgr,	const int attrByteOffset,	const Datatype attrType);
 	
  public:
 
@@ -321,6 +340,21 @@ class BTreeIndex {
    */
 	BTreeIndex(const std::string & relationName, std::string & outIndexName,
 						BufMgr *bufMgrIn,	const int attrByteOffset,	const Datatype attrType);
+
+  /**
+   * BTreeIndex Constructor taking its buffer pools from a registry: the index file uses the pool assigned to it
+   * (by default the index pool) and the scan of the base relation while building the index uses the relation's.
+   *
+   * @param relationName        Name of file.
+   * @param outIndexName        Return the name of index file.
+   * @param pools								Buffer pools to use
+   * @param attrByteOffset			Offset of attribute, over which index is to be built, in the record
+   * @param attrType						Datatype of attribute over which index is built
+   * @throws  BadIndexInfoException     If the index file already exists for the corresponding attribute, but values in metapage(relationName, attribute byte offset, attribute type etc.) do not match with values received through constructor parameters.
+   * @throws  PoolNotFoundException     If the pool of the index file or of the relation does not exist.
+   */
+	BTreeIndex(const std::string & relationName, std::string & outIndexName,
+						BufPoolRegistry *pools,	const int attrByteOffset,	const Datatype attrType);
 	
 
   /**
@@ -344,10 +378,11 @@ class BTreeIndex {
 	void insertEntry(const void* key, const RecordId rid);
 
 /*
- * Helper method for insertEntry
+ * Helper method for insertEntry. cursorHandle pins the page of cursor; its child links are unswizzled before
+ * they are moved.
 */
   void insertInternal(int k, RecordId x,
-                            NonLeafNodeInt* cursor,
+                            NonLeafNodeInt* cursor, const PageHandle& cursorHandle,
                             void* child, RecordId cursorRID, PageId child_page_id);
 
   /**
@@ -378,6 +413,16 @@ class BTreeIndex {
 	void scanNext(RecordId& outRid);  // returned record id
 
 
+  /**
+	 * Fetch the record id of the next index entry that matches the scan, like scanNext(), but report the end of the
+	 * scan through the return value instead of an exception.
+   * @param outRid	RecordId of next record found that satisfies the scan criteria returned in this
+	 * @return False if no more records, satisfying the scan criteria, are left to be scanned.
+	 * @throws ScanNotInitializedException If no scan has been initialized.
+	**/
+	bool tryScanNext(RecordId& outRid);
+
+
   /**
 	 * Terminate the current scan. Unpin any pinned pages. Reset scan specific variables.
 	 * @throws ScanNotInitializedException If no scan has been initialized.
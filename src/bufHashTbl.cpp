@@ -7,6 +7,7 @@
 
 #include <memory>
 #include <iostream>
+#include <cstdint>
 #include "buffer.h"
 #include "bufHashTbl.h"
 #include "exceptions/hash_already_present_exception.h"
@@ -17,10 +18,8 @@ namespace badgerdb {
 
 int BufHashTbl::hash(const File* file, const PageId pageNo)
 {
-  int tmp, value;
-  tmp = (long)file;  // cast of pointer to the file object to an integer
-  value = (tmp + pageNo) % HTSIZE;
-  return value;
+  std::uintptr_t tmp = reinterpret_cast<std::uintptr_t>(file);  // cast of pointer to the file object to an integer
+  return (int) ((tmp + pageNo) % HTSIZE);
 }
 
 BufHashTbl::BufHashTbl(int htSize)
@@ -46,13 +45,35 @@ BufHashTbl::~BufHashTbl()
 }
 
 void BufHashTbl::insert(const File* file, const PageId pageNo, const FrameId frameNo)
+{
+  if (!tryInsert(file, pageNo, frameNo))
+  {
+    FrameId present = 0;
+    tryLookup(file, pageNo, present);
+  	throw HashAlreadyPresentException(file->filename(), pageNo, present);
+  }
+}
+
+void BufHashTbl::lookup(const File* file, const PageId pageNo, FrameId &frameNo) 
+{
+  if (!tryLookup(file, pageNo, frameNo))
+    throw HashNotFoundException(file->filename(), pageNo);
+}
+
+void BufHashTbl::remove(const File* file, const PageId pageNo) {
+  if (!tryRemove(file, pageNo))
+    throw HashNotFoundException(file->filename(), pageNo);
+}
+
+bool BufHashTbl::tryInsert(const File* file, const PageId pageNo, const FrameId frameNo)
 {
   int index = hash(file, pageNo);
+  std::lock_guard<std::mutex> guard(stripes[index % HTSTRIPES]);
 
   hashBucket* tmpBuc = ht[index];
   while (tmpBuc) {
     if (tmpBuc->file == file && tmpBuc->pageNo == pageNo)
-  		throw HashAlreadyPresentException(tmpBuc->file->filename(), tmpBuc->pageNo, tmpBuc->frameNo);
+      return false;
     tmpBuc = tmpBuc->next;
   }
 
@@ -65,27 +86,30 @@ void BufHashTbl::insert(const File* file, const PageId pageNo, const FrameId fra
   tmpBuc->frameNo = frameNo;
   tmpBuc->next = ht[index];
   ht[index] = tmpBuc;
+  return true;
 }
 
-void BufHashTbl::lookup(const File* file, const PageId pageNo, FrameId &frameNo) 
+bool BufHashTbl::tryLookup(const File* file, const PageId pageNo, FrameId &frameNo) 
 {
   int index = hash(file, pageNo);
+  std::lock_guard<std::mutex> guard(stripes[index % HTSTRIPES]);
   hashBucket* tmpBuc = ht[index];
   while (tmpBuc) {
     if (tmpBuc->file == file && tmpBuc->pageNo == pageNo)
     {
       frameNo = tmpBuc->frameNo; // return frameNo by reference
-      return;
+      return true;
     }
     tmpBuc = tmpBuc->next;
   }
 
-  throw HashNotFoundException(file->filename(), pageNo);
+  return false;
 }
 
-void BufHashTbl::remove(const File* file, const PageId pageNo) {
+bool BufHashTbl::tryRemove(const File* file, const PageId pageNo) {
 
   int index = hash(file, pageNo);
+  std::lock_guard<std::mutex> guard(stripes[index % HTSTRIPES]);
   hashBucket* tmpBuc = ht[index];
   hashBucket* prevBuc = NULL;
 
@@ -99,7 +123,7 @@ void BufHashTbl::remove(const File* file, const PageId pageNo) {
 				ht[index] = tmpBuc->next;
 
       delete tmpBuc;
-      return;
+      return true;
     }
 		else
 		{
@@ -108,7 +132,22 @@ void BufHashTbl::remove(const File* file, const PageId pageNo) {
     }
   }
 
-  throw HashNotFoundException(file->filename(), pageNo);
+  return false;
+}
+
+bool BufHashTbl::tryMove(const File* file, const PageId pageNo, const FrameId frameNo)
+{
+  int index = hash(file, pageNo);
+  std::lock_guard<std::mutex> guard(stripes[index % HTSTRIPES]);
+  for (hashBucket* tmpBuc = ht[index]; tmpBuc; tmpBuc = tmpBuc->next)
+  {
+    if (tmpBuc->file == file && tmpBuc->pageNo == pageNo)
+    {
+      tmpBuc->frameNo = frameNo;
+      return true;
+    }
+  }
+  return false;
 }
 
 }
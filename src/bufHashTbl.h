@@ -7,6 +7,7 @@
 
 #pragma once
 
+#include <mutex>
 #include "file.h"
 
 namespace badgerdb {
@@ -40,11 +41,18 @@ struct hashBucket {
 /**
 * @brief Hash table class to keep track of pages in the buffer pool
 *
-* @warning This class is not threadsafe.
+* The bucket array is partitioned into HTSTRIPES lock stripes; every operation
+* only takes the latch of the stripe its bucket falls in, so threads working on
+* different pages rarely contend with each other.
 */
 class BufHashTbl
 {
  private:
+	/**
+	 * Number of latch stripes the buckets are partitioned into
+	 */
+  static const int HTSTRIPES = 64;
+
 	/**
 	 *	Size of Hash Table
 	 */
@@ -54,6 +62,11 @@ class BufHashTbl
 	 */
   hashBucket**  ht;
 
+	/**
+	 * Latches protecting the bucket chains. Bucket i is protected by stripes[i % HTSTRIPES].
+	 */
+  std::mutex stripes[HTSTRIPES];
+
 	/**
 	 * returns hash value between 0 and HTSIZE-1 computed using file and pageNo
 	 *
@@ -104,6 +117,46 @@ class BufHashTbl
    * @throws HashNotFoundException if the page entry is not found in the hash table 
 	 */
   void remove(const File* file, const PageId pageNo);  
+
+	/**
+   * Insert entry into hash table mapping (file, pageNo) to frameNo, unless the page is already there.
+	 *
+	 * @param file   	File object
+	 * @param pageNo 	Page number in the file
+	 * @param frameNo Frame number assigned to that page of the file
+	 * @return  			False if the page already exists in the hash table
+	 */
+  bool tryInsert(const File* file, const PageId pageNo, const FrameId frameNo);
+
+	/**
+   * Check if (file, pageNo) is currently in the buffer pool, without throwing when it is not.
+	 *
+	 * @param file  	File object
+	 * @param pageNo	Page number in the file
+	 * @param frameNo Frame number reference, set only if the page is found
+	 * @return  			False if the page entry is not found in the hash table
+	 */
+  bool tryLookup(const File* file, const PageId pageNo, FrameId &frameNo);
+
+	/**
+   * Delete entry (file,pageNo) from hash table if it is there.
+	 *
+	 * @param file   	File object
+	 * @param pageNo  Page number in the file
+	 * @return  			False if the page entry is not found in the hash table
+	 */
+  bool tryRemove(const File* file, const PageId pageNo);
+
+	/**
+   * Change the frame the entry (file,pageNo) maps to, if it is there. The page never goes missing from the
+   * table while it moves.
+	 *
+	 * @param file   	File object
+	 * @param pageNo  Page number in the file
+	 * @param frameNo New frame number of the page
+	 * @return  			False if the page entry is not found in the hash table
+	 */
+  bool tryMove(const File* file, const PageId pageNo, const FrameId frameNo);
 };
 
 }
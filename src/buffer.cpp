@@ -7,235 +7,1414 @@
 
 #include <memory>
 #include <iostream>
+#include <functional>
+#include <vector>
+#include <algorithm>
+#include <deque>
+#include <map>
+#include <fstream>
+#include <cstdio>
 #include "buffer.h"
 #include "exceptions/buffer_exceeded_exception.h"
 #include "exceptions/page_not_pinned_exception.h"
 #include "exceptions/page_pinned_exception.h"
 #include "exceptions/bad_buffer_exception.h"
 #include "exceptions/hash_not_found_exception.h"
+#include "exceptions/hash_already_present_exception.h"
+#include "exceptions/invalid_pool_size_exception.h"
 
 namespace badgerdb { 
 
+// frames are read into and written from directly by files opened for direct I/O
+static_assert(PagePool::FRAME_ALIGNMENT % File::DIRECT_IO_ALIGNMENT == 0,
+              "buffer pool frames must be aligned for direct I/O");
+
+// first line of the files written by saveResidentSet()
+static const std::string RESIDENT_SET_HEADER = "badgerdb resident set 1";
+
 //----------------------------------------
 // Constructor of the class BufMgr
 //----------------------------------------
 
-BufMgr::BufMgr(std::uint32_t bufs)
-	: numBufs(bufs) {
-	bufDescTable = new BufDesc[bufs];
+BufMgr::BufMgr(std::uint32_t bufs, const ReplacementPolicyType policyType, const PoolAllocation allocation)
+	: numBufs(0), hashTable(NULL), poolAllocation(allocation), victimCache(0), bgWriterPages(0), dirtySeq(0),
+	  checkpointerPages(0), log(NULL),
+	  prefetchStopping(false),
+	  prefetchBusyFile(NULL) {
+  if (bufs == 0)
+    throw InvalidPoolSizeException(bufs);
+
+  addChunk(bufs);
+  numBufs = bufs;
+  rebuildHashTable();  // allocate the buffer hash table
+
+  policy = ReplacementPolicy::create(policyType, bufs);
+}
+
+
+BufMgr::~BufMgr() {
+  stopBgWriter();
+  stopCheckpointer();
 
-  for (FrameId i = 0; i < bufs; i++) 
   {
-  	bufDescTable[i].frameNo = i;
-  	bufDescTable[i].valid = false;
+    std::lock_guard<std::mutex> guard(prefetchMutex);
+    prefetchStopping = true;
   }
+  prefetchReady.notify_all();
+  if (prefetcher.joinable())
+    prefetcher.join();
 
-  bufPool = new Page[bufs];
+  //Flush out all unwritten pages, including those left above the last shrink
+  std::vector<FrameId> frames;
+  for (FrameId i = 0; i < bufDescTable.size(); i++)
+    frames.push_back(i);
+  writeDirtyFrames(frames);
 
-  int htsize = ((((int) (bufs * 1.2))*2)/2)+1;
-  hashTable = new BufHashTbl (htsize);  // allocate the buffer hash table
+	delete hashTable;
+  delete policy;
+  for (std::size_t i = 0; i < chunks.size(); i++)
+  {
+    delete [] chunks[i].descs;
+    delete chunks[i].pages;
+  }
+}
+
+void BufMgr::addChunk(const std::uint32_t count)
+{
+  FrameChunk chunk;
+  chunk.first = bufDescTable.size();
+  chunk.count = count;
+  chunk.pages = new PagePool(count, poolAllocation);
+  chunk.descs = new BufDesc[count];
+  chunks.push_back(chunk);
 
-  clockHand = bufs - 1;
+  for (std::uint32_t i = 0; i < count; i++)
+  {
+    chunk.descs[i].frameNo = chunk.first + i;
+    bufDescTable.push_back(&chunk.descs[i]);
+    bufPool.push_back(&chunk.pages->pages()[i]);
+  }
 }
 
+void BufMgr::rebuildHashTable()
+{
+  int htsize = ((((int) (numBufs * 1.2))*2)/2)+1;
+  BufHashTbl* newTable = new BufHashTbl (htsize);
+  for (FrameId i = 0; i < bufDescTable.size(); i++)
+  {
+    if (bufDescTable[i]->valid)
+      newTable->insert(bufDescTable[i]->file, bufDescTable[i]->pageNo, i);
+  }
+  delete hashTable;
+  hashTable = newTable;
+}
 
-BufMgr::~BufMgr() {
-  //Flush out all unwritten pages
-  for (std::uint32_t i = 0; i < numBufs; i++) 
+void BufMgr::writeDirtyFrames(const std::vector<FrameId>& frames)
+{
+  // one sorted batch and one sync per file
+  std::map<File*, std::vector<std::pair<PageId, const Page*> > > dirtyPages;
+  Lsn maxLsn = 0;
+  for (std::size_t i = 0; i < frames.size(); i++) 
   {
-  	BufDesc* tmpbuf = &(bufDescTable[i]);
+  	BufDesc* tmpbuf = bufDescTable[frames[i]];
   	if (tmpbuf->valid == true && tmpbuf->dirty == true)
 		{
-			tmpbuf->file->writePage(tmpbuf->pageNo, bufPool[i]);
+			unswizzleChildren(frames[i]);
+			dirtyPages[tmpbuf->file].push_back(std::make_pair(tmpbuf->pageNo, bufPool[frames[i]]));
+			maxLsn = std::max(maxLsn, tmpbuf->pageLsn);
   	}
   }
+  flushLogTo(maxLsn);
+  for (std::map<File*, std::vector<std::pair<PageId, const Page*> > >::iterator it = dirtyPages.begin();
+       it != dirtyPages.end(); ++it)
+  {
+    it->first->writePages(it->second);
+    it->first->sync();
+    bufStats.diskwrites += it->second.size();
+  }
 
-	delete hashTable;
-  delete [] bufDescTable;
-  delete [] bufPool;
+  for (std::size_t i = 0; i < frames.size(); i++) 
+    markClean(frames[i]);
 }
 
-void BufMgr::allocBuf(FrameId & frame) 
+void BufMgr::resize(const std::uint32_t newFrames)
 {
-  // perform first part of clock algorithm to search for 
-  // open buffer frame
-  // Assumes non-concurrent access to buffer manager
-  std::uint32_t numScanned = 0;
-  bool found = 0;
+  if (newFrames == 0)
+    throw InvalidPoolSizeException(newFrames);
 
-  while (numScanned < 2*numBufs)	//Need to scn twice
+  resizeGate.close();
+  try
   {
-    // advance the clock
-    advanceClock();
-    numScanned++;
+    const std::uint32_t oldFrames = numBufs;
+    if (newFrames < numBufs)
+    {
+      // nothing else runs now, so the frames need no latching. Pinned pages
+      // can not move, since their users hold pointers to them; those above
+      // the cut stay there until they are unpinned (see retireFrame()), which
+      // only works out if they fit below it.
+      std::uint32_t pinned = 0;
+      FrameId pinnedAbove = NO_FRAME;
+      for (FrameId i = 0; i < bufDescTable.size(); i++)
+      {
+        if (bufDescTable[i]->valid && bufDescTable[i]->pinCnt > 0)
+        {
+          pinned++;
+          if (i >= newFrames && pinnedAbove == NO_FRAME)
+            pinnedAbove = i;
+        }
+      }
+      if (pinned > newFrames)
+      {
+        BufDesc* tmpbuf = bufDescTable[pinnedAbove];
+        throw PagePinnedException(tmpbuf->file->filename(), tmpbuf->pageNo, pinnedAbove);
+      }
+
+      // unpinned pages above the cut move to empty frames below it. The ones
+      // there is no room for are dropped; they are written first, so that a
+      // failure leaves the pool as it was.
+      std::vector<std::pair<FrameId, FrameId> > moves;
+      std::vector<FrameId> dropped;
+      FrameId empty = 0;
+      for (FrameId i = newFrames; i < bufDescTable.size(); i++)
+      {
+        BufDesc* tmpbuf = bufDescTable[i];
+        if (!tmpbuf->valid || tmpbuf->pinCnt > 0)
+          continue;
+        while (empty < newFrames && bufDescTable[empty]->valid)
+          empty++;
+        if (empty < newFrames)
+          moves.push_back(std::make_pair(i, empty++));
+        else
+          dropped.push_back(i);
+      }
+      writeDirtyFrames(dropped);
+
+      for (std::size_t i = 0; i < moves.size(); i++)
+      {
+        moveFrame(moves[i].first, moves[i].second);
+        BufDesc* tmpbuf = bufDescTable[moves[i].second];
+        policy->pageLoaded(moves[i].second, tmpbuf->file, tmpbuf->pageNo);
+      }
+      for (std::size_t i = 0; i < dropped.size(); i++)
+        clearFrame(dropped[i]);
+      for (FrameId i = newFrames; i < numBufs; i++)
+        policy->frameFreed(i);
+    }
+    else if (newFrames > bufDescTable.size())
+    {
+      // frames left allocated by an earlier shrink are reused first
+      addChunk(newFrames - bufDescTable.size());
+    }
 
-    // if invalid, use frame
-    if (! bufDescTable[clockHand].valid)
+    numBufs = newFrames;
+    policy->resize(newFrames);
+
+    // frames taken back by growing may still hold pages pinned at the last shrink
+    for (FrameId i = oldFrames; i < newFrames; i++)
     {
-      break;
+      BufDesc* tmpbuf = bufDescTable[i];
+      if (tmpbuf->valid)
+        policy->pageLoaded(i, tmpbuf->file, tmpbuf->pageNo);
     }
 
-    // is valid, check referenced bit
-    if (! bufDescTable[clockHand].refbit)
+    // free the chunks above the cut that no longer hold a page
+    while (chunks.back().first >= newFrames)
     {
-      // check to see if someone has it pinned
-      if (bufDescTable[clockHand].pinCnt == 0)
-      {
-        // hasn't been referenced and is not pinned, use it
-        // remove previous entry from hash table
-        hashTable->remove(bufDescTable[clockHand].file, bufDescTable[clockHand].pageNo);
-        found = true;
+      const FrameChunk& chunk = chunks.back();
+      bool used = false;
+      for (std::uint32_t i = 0; i < chunk.count && !used; i++)
+        used = chunk.descs[i].valid;
+      if (used)
         break;
-      }
+      delete [] chunk.descs;
+      delete chunk.pages;
+      chunks.pop_back();
     }
-    else
+    bufDescTable.resize(chunks.back().first + chunks.back().count);
+    bufPool.resize(chunks.back().first + chunks.back().count);
+
+    rebuildHashTable();
+  }
+  catch (...)
+  {
+    resizeGate.open();
+    throw;
+  }
+  resizeGate.open();
+}
+
+bool BufMgr::latchIfEvictable(const FrameId frame)
+{
+  BufDesc* tmpbuf = bufDescTable[frame];
+  bufStats.sweepSteps++;
+  if (!tmpbuf->latch.try_lock())
+    return false;
+
+  // use the frame if it is invalid or nobody has it pinned. Pages with
+  // swizzled references stay until their children are gone.
+  if (!tmpbuf->valid || (tmpbuf->pinCnt == 0 && tmpbuf->swizzledChildren == 0))
+    return true;
+
+  tmpbuf->latch.unlock();
+  return false;
+}
+
+void BufMgr::moveFrame(const FrameId from, const FrameId to)
+{
+  BufDesc* src = bufDescTable[from];
+  BufDesc* dst = bufDescTable[to];
+
+  *bufPool[to] = *bufPool[from];
+  assignFrame(to, src->file, src->pageNo);
+  dst->pinCnt = src->pinCnt;
+  dst->prefetched = src->prefetched;
+  dst->pageLsn = src->pageLsn;
+  dst->recLsn = src->recLsn;
+  dst->pinLsn = src->pinLsn;
+  if (src->dirty)
+  {
+    // keep the page's place in the dirty page table
+    std::lock_guard<std::mutex> guard(dirtyTableMutex);
+    dirtyTable.erase(std::make_pair(src->firstDirtied, from));
+    dst->dirty = true;
+    dst->firstDirtied = src->firstDirtied;
+    dirtyTable.insert(std::make_pair(dst->firstDirtied, to));
+    src->dirty = false;
+    src->firstDirtied = 0;
+  }
+
+  // swizzled references name the frame: repoint the slot that refers to the
+  // page, and the slots in the page, which now live in the copy
+  {
+    std::lock_guard<std::mutex> guard(swizzleMutex);
+    PageId* slot = src->swizzleSlot.exchange(NULL);
+    if (slot != NULL)
+    {
+      dst->swizzledPageNo = src->swizzledPageNo;
+      dst->swizzleParent = src->swizzleParent;
+      dst->swizzleSlot = slot;
+      __atomic_store_n(slot, SWIZZLED_BIT | to, __ATOMIC_RELEASE);
+      src->swizzleParent = NO_FRAME;
+      src->swizzledPageNo = Page::INVALID_NUMBER;
+    }
+    const std::ptrdiff_t offset = reinterpret_cast<char*>(bufPool[to]) - reinterpret_cast<char*>(bufPool[from]);
+    for (FrameId i = 0; i < bufDescTable.size() && src->swizzledChildren > 0; i++)
     {
-      // has been referenced, clear the bit
-      bufStats.accesses++;
-      bufDescTable[clockHand].refbit = false;
+      BufDesc* child = bufDescTable[i];
+      if (child->swizzleSlot != NULL && child->swizzleParent == from)
+      {
+        child->swizzleSlot = reinterpret_cast<PageId*>(reinterpret_cast<char*>(child->swizzleSlot.load()) + offset);
+        child->swizzleParent = to;
+        src->swizzledChildren--;
+        dst->swizzledChildren++;
+      }
     }
   }
-  
-  // check for full buffer pool
-  if (!found && numScanned >= 2*numBufs)
+
+  hashTable->tryMove(dst->file, dst->pageNo, to);
+  clearFrame(from);
+}
+
+void BufMgr::retireFrame(const FrameId frame)
+{
+  // move the page to a frame below the cut, unless every one of them is pinned
+  FrameId target = 0;
+  if (allocBuf(target))
   {
-    throw BufferExceededException();
+    moveFrame(frame, target);
+    BufDesc* tmpbuf = bufDescTable[target];
+    policy->pageLoaded(target, tmpbuf->file, tmpbuf->pageNo);
+    tmpbuf->latch.unlock();
+    return;
   }
-  
-  // flush any existing changes to disk if necessary
-  if (bufDescTable[clockHand].dirty)
+
+  BufDesc* tmpbuf = bufDescTable[frame];
+  if (tmpbuf->dirty)
   {
+    unswizzleChildren(frame);
     bufStats.diskwrites++;
-    //status = bufDescTable[clockHand].file->writePage(bufDescTable[clockHand].pageNo,
-    bufDescTable[clockHand].file->writePage(bufDescTable[clockHand].pageNo, bufPool[clockHand]);
+    flushLogTo(tmpbuf->pageLsn);
+    tmpbuf->file->writePage(tmpbuf->pageNo, *bufPool[frame]);
+  }
+  hashTable->remove(tmpbuf->file, tmpbuf->pageNo);
+  clearFrame(frame);
+}
+
+void BufMgr::releaseFrame(const FrameId frame)
+{
+  BufDesc* tmpbuf = bufDescTable[frame];
+  clearFrame(frame);
+  policy->frameFreed(frame);
+  tmpbuf->latch.unlock();
+}
+
+bool BufMgr::allocBuf(FrameId & frame) 
+{
+  // ask the replacement policy for a frame that is free or unpinned
+  FrameId candidate = 0;
+  if (!policy->selectVictim(std::bind(&BufMgr::latchIfEvictable, this, std::placeholders::_1), candidate))
+  {
+    return false;
+  }
+  BufDesc* tmpbuf = bufDescTable[candidate];
+  
+  if (tmpbuf->valid)
+  {
+    // flush any existing changes to disk if necessary. This happens before the
+    // hash table entry goes away, so a concurrent miss on the same page can not
+    // read the stale copy from disk.
+    if (tmpbuf->dirty)
+    {
+      bufStats.diskwrites++;
+      try
+      {
+        flushLogTo(tmpbuf->pageLsn);
+        tmpbuf->file->writePage(tmpbuf->pageNo, *bufPool[candidate]);
+      }
+      catch (...)
+      {
+        // the page stays where it is
+        policy->victimKept(candidate);
+        tmpbuf->latch.unlock();
+        throw;
+      }
+    }
+    bufStats.countEviction(*tmpbuf->counters, tmpbuf->dirty);
+
+    // keep a compressed copy, now that the page matches the disk. Misses on
+    // the page still find the hash table entry and wait for the latch, so
+    // none of them goes to disk before the copy is in place.
+    if (victimCache.put(tmpbuf->file, tmpbuf->pageNo, *bufPool[candidate]))
+      bufStats.victimStores++;
+
+    // remove previous entry from hash table
+    hashTable->remove(tmpbuf->file, tmpbuf->pageNo);
   }
 
 	//Reset all the BufDesc entry for the frame before returning the frame
-  bufDescTable[clockHand].Clear();
+  clearFrame(candidate);
 
   // return new frame number
-  frame = clockHand;
+  frame = candidate;
+  return true;
 } // end allocBuf
 
 	
-void BufMgr::readPage(File* file, const PageId pageNo, Page*& page)
+BufMgr::LoadStatus BufMgr::loadPage(File* file, const PageId pageNo, const bool pin, FrameId& frameNo)
+{
+  // alloc a new frame, it comes back latched
+  if (!allocBuf(frameNo))
+    return NO_FREE_FRAME;
+  BufDesc* tmpbuf = bufDescTable[frameNo];
+
+  // claim the page in the hash table before doing the I/O; if another
+  // thread got there first, give the frame back and use its copy
+  if (!hashTable->tryInsert(file, pageNo, frameNo))
+  {
+    releaseFrame(frameNo);
+    return PAGE_CLAIMED;
+  }
+
+  // read the page into the new frame, from the victim cache if it is there
+  try
+  {
+    if (victimCache.take(file, pageNo, *bufPool[frameNo]))
+      bufStats.victimHits++;
+    else
+    {
+      bufStats.diskreads++;
+      file->readPageInto(pageNo, *bufPool[frameNo]);
+    }
+  }
+  catch (...)
+  {
+    hashTable->remove(file, pageNo);
+    releaseFrame(frameNo);
+    throw;
+  }
+
+  // set up the entry properly
+  assignFrame(frameNo, file, pageNo);
+  if (!pin)
+  {
+    tmpbuf->pinCnt = 0;
+    tmpbuf->prefetched = true;
+  }
+  policy->pageLoaded(frameNo, file, pageNo);
+  tmpbuf->latch.unlock();
+  return PAGE_LOADED;
+}
+
+bool BufMgr::pinPage(File* file, const PageId pageNo, FrameId& frameNo)
 {
   // check to see if it is already in the buffer pool
   // std::cout << "readPage called on file.page " << file << "." << pageNo << endl;
+  bufStats.accesses++;
+  while (true)
+  {
+    if (!hashTable->tryLookup(file, pageNo, frameNo)) //not in the buffer pool, must allocate a new page
+    {
+      const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+      LoadStatus status = loadPage(file, pageNo, true, frameNo);
+      if (status == PAGE_CLAIMED)
+        continue;
+      if (status != PAGE_LOADED)
+        return false;
+      // the frame is pinned, so its counters can not change under us
+      bufStats.countMiss(*bufDescTable[frameNo]->counters, std::chrono::steady_clock::now() - start);
+      return true;
+    }
+
+    // the frame may have been recycled between the lookup and taking the
+    // latch, in which case go around again. A latch that is held is mostly a
+    // read of the page in progress.
+    BufDesc* tmpbuf = bufDescTable[frameNo];
+    std::unique_lock<std::mutex> lock(tmpbuf->latch, std::try_to_lock);
+    if (!lock.owns_lock())
+    {
+      bufStats.pinWaits++;
+      lock.lock();
+    }
+    if (tmpbuf->valid && tmpbuf->file == file && tmpbuf->pageNo == pageNo)
+    {
+      // let the replacement policy know about the reference. Loading a
+      // prefetched page already counted as its first one.
+      bufStats.countHit(*tmpbuf->counters);
+      if (tmpbuf->prefetched)
+        tmpbuf->prefetched = false;
+      else if (frameNo < numBufs)
+        policy->pageAccessed(frameNo);
+      pinFrame(frameNo);
+      return true;
+    }
+  }
+}
+
+void BufMgr::readPage(File* file, const PageId pageNo, Page*& page)
+{
+  if (!tryReadPage(file, pageNo, page))
+    throw BufferExceededException();
+}
+
+PageHandle BufMgr::readPage(File* file, const PageId pageNo)
+{
+  PageHandle handle;
+  if (!tryReadPage(file, pageNo, handle))
+    throw BufferExceededException();
+  return handle;
+}
+
+bool BufMgr::tryReadPage(File* file, const PageId pageNo, Page*& page)
+{
+  SharedGate::Guard gate(resizeGate);
   FrameId frameNo = 0;
-	try
-	{
-  	hashTable->lookup(file, pageNo, frameNo);
+  if (!pinPage(file, pageNo, frameNo))
+    return false;
+  page = bufPool[frameNo];
+  return true;
+}
+
+bool BufMgr::tryReadPage(File* file, const PageId pageNo, PageHandle& handle)
+{
+  SharedGate::Guard gate(resizeGate);
+  FrameId frameNo = 0;
+  if (!pinPage(file, pageNo, frameNo))
+    return false;
+  handle = PageHandle(this, frameNo, bufPool[frameNo]);
+  return true;
+}
+
+PageHandle BufMgr::readChild(File* file, const PageHandle& parent, PageId* slot, PageId& pageNo)
+{
+  SharedGate::Guard gate(resizeGate);
 
-    // set the referenced bit
-    bufDescTable[frameNo].refbit = true;
-    bufDescTable[frameNo].pinCnt++;
-    page = &bufPool[frameNo];
+  PageId ref = __atomic_load_n(slot, __ATOMIC_ACQUIRE);
+  while (ref & SWIZZLED_BIT)
+  {
+    // the reference is good as long as the frame is registered for the slot;
+    // otherwise it is being restored right now, so look again
+    const FrameId frameNo = ref & ~SWIZZLED_BIT;
+    BufDesc* tmpbuf = bufDescTable[frameNo];
+    {
+      std::lock_guard<std::mutex> guard(tmpbuf->latch);
+      if (tmpbuf->swizzleSlot == slot)
+      {
+        bufStats.accesses++;
+        bufStats.swizzledHits++;
+        bufStats.countHit(*tmpbuf->counters);
+        if (tmpbuf->prefetched)
+          tmpbuf->prefetched = false;
+        else if (frameNo < numBufs)
+          policy->pageAccessed(frameNo);
+        pinFrame(frameNo);
+        pageNo = tmpbuf->pageNo;
+        return PageHandle(this, frameNo, bufPool[frameNo]);
+      }
+    }
+    std::this_thread::yield();
+    ref = __atomic_load_n(slot, __ATOMIC_ACQUIRE);
+  }
+
+  FrameId frameNo = 0;
+  if (!pinPage(file, ref, frameNo))
+    throw BufferExceededException();
+  pageNo = ref;
+
+  // swizzle the reference, unless the child already has a swizzled reference
+  // elsewhere. The parent's latch keeps writers of the parent away while the
+  // slot changes; it is only tried, since the child's latch is held already.
+  BufDesc* tmpbuf = bufDescTable[frameNo];
+  BufDesc* parentbuf = bufDescTable[parent.frameNo];
+  std::lock_guard<std::mutex> guard(tmpbuf->latch);
+  if (tmpbuf->swizzleSlot == NULL && parentbuf->latch.try_lock())
+  {
+    {
+      std::lock_guard<std::mutex> swizzleGuard(swizzleMutex);
+      if (__atomic_load_n(slot, __ATOMIC_RELAXED) == ref)
+      {
+        tmpbuf->swizzledPageNo = ref;
+        tmpbuf->swizzleParent = parent.frameNo;
+        parentbuf->swizzledChildren++;
+        tmpbuf->swizzleSlot = slot;
+        __atomic_store_n(slot, SWIZZLED_BIT | frameNo, __ATOMIC_RELEASE);
+      }
+    }
+    parentbuf->latch.unlock();
   }
-  catch(const HashNotFoundException &e) //not in the buffer pool, must allocate a new page
+  return PageHandle(this, frameNo, bufPool[frameNo]);
+}
+
+void BufMgr::unswizzle(const PageHandle& parent)
+{
+  SharedGate::Guard gate(resizeGate);
+  std::lock_guard<std::mutex> guard(bufDescTable[parent.frameNo]->latch);
+  unswizzleChildren(parent.frameNo);
+}
+
+void BufMgr::prefetch(File* file, const PageId firstPageNo, const std::uint32_t count)
+{
+  std::vector<PageId> pageNos;
+  for (std::uint32_t i = 0; i < count; i++)
+    pageNos.push_back(firstPageNo + i);
+  prefetch(file, pageNos);
+}
+
+void BufMgr::prefetch(File* file, const std::vector<PageId>& pageNos)
+{
+  SharedGate::Guard gate(resizeGate);
+  std::lock_guard<std::mutex> guard(prefetchMutex);
+  if (!prefetcher.joinable())
   {
-    // alloc a new frame
-    allocBuf(frameNo);
+    prefetchStopping = false;
+    prefetcher = std::thread(&BufMgr::prefetchLoop, this);
+  }
 
-    // read the page into the new frame
-    bufStats.diskreads++;
-    //status = file->readPage(pageNo, &bufPool[frameNo]);
-    bufPool[frameNo] = file->readPage(pageNo);
+  for (std::size_t i = 0; i < pageNos.size(); i++)
+  {
+    // never queue more than half the pool; read-ahead beyond that would only evict itself
+    if (prefetchQueue.size() >= numBufs / 2)
+      break;
+    if (pageNos[i] != Page::INVALID_NUMBER)
+      prefetchQueue.push_back(std::make_pair(file, pageNos[i]));
+  }
+  prefetchReady.notify_one();
+}
+
+bool BufMgr::saveResidentSet(const std::string& path)
+{
+  SharedGate::Guard gate(resizeGate);
+
+  // the policy lists the likeliest victims first; save the pages the other way round
+  std::vector<FrameId> frames;
+  policy->nextVictims(frames, numBufs);
+
+  const std::string tmpPath = path + ".tmp";
+  std::ofstream out(tmpPath.c_str(), std::ios::out | std::ios::trunc);
+  if (!out)
+    return false;
+  out << RESIDENT_SET_HEADER << "\n";
+  for (std::vector<FrameId>::reverse_iterator it = frames.rbegin(); it != frames.rend(); ++it)
+  {
+    BufDesc* tmpbuf = bufDescTable[*it];
+    std::lock_guard<std::mutex> guard(tmpbuf->latch);
+    if (tmpbuf->valid)
+      out << tmpbuf->pageNo << ' ' << tmpbuf->file->filename() << '\n';
+  }
+  out.close();
+  if (!out)
+    return false;
+  return std::rename(tmpPath.c_str(), path.c_str()) == 0;
+}
+
+std::uint32_t BufMgr::warmFrom(const std::string& path, const std::vector<File*>& files)
+{
+  SharedGate::Guard gate(resizeGate);
+
+  std::ifstream in(path.c_str());
+  std::string line;
+  if (!in || !std::getline(in, line) || line != RESIDENT_SET_HEADER)
+    return 0;
+
+  std::map<std::string, File*> byName;
+  for (std::size_t i = 0; i < files.size(); i++)
+    byName[files[i]->filename()] = files[i];
+
+  // take the hottest pages that fit in the pool, then read them file by file
+  std::map<File*, std::vector<PageId> > pageNos;
+  std::uint32_t listed = 0;
+  PageId pageNo;
+  while (listed < numBufs && in >> pageNo && in.get() == ' ' && std::getline(in, line))
+  {
+    std::map<std::string, File*>::iterator file = byName.find(line);
+    if (file == byName.end())
+      continue;
+    pageNos[file->second].push_back(pageNo);
+    listed++;
+  }
+
+  std::uint32_t loaded = 0;
+  for (std::map<File*, std::vector<PageId> >::iterator it = pageNos.begin(); it != pageNos.end(); ++it)
+  {
+    std::vector<PageId>& list = it->second;
+    std::sort(list.begin(), list.end());
+    list.erase(std::unique(list.begin(), list.end()), list.end());
+
+    std::vector<PageId> run;
+    for (std::size_t i = 0; i < list.size(); i++)
+    {
+      if (!run.empty() && (list[i] != run.back() + 1 || run.size() == WARM_READ_RUN))
+      {
+        if (!warmRun(it->first, run, loaded))
+          return loaded;
+        run.clear();
+      }
+      run.push_back(list[i]);
+    }
+    if (!run.empty() && !warmRun(it->first, run, loaded))
+      return loaded;
+  }
+  return loaded;
+}
+
+bool BufMgr::warmRun(File* file, const std::vector<PageId>& run, std::uint32_t& loaded)
+{
+  // claim a frame and the hash table entry of every page not in the pool yet;
+  // the frames stay latched until their page is in place
+  std::vector<std::pair<PageId, FrameId> > claimed;
+  bool complete = true;
+  for (std::size_t i = 0; i < run.size(); i++)
+  {
+    FrameId frameNo;
+    if (hashTable->tryLookup(file, run[i], frameNo))
+      continue;
+    if (!allocBuf(frameNo))
+    {
+      complete = false;
+      break;
+    }
+    if (!hashTable->tryInsert(file, run[i], frameNo))
+    {
+      releaseFrame(frameNo);
+      continue;
+    }
+    claimed.push_back(std::make_pair(run[i], frameNo));
+  }
+  if (claimed.empty())
+    return complete;
+
+  // one read covering all of them
+  std::vector<std::pair<PageId, Page> > pages;
+  try
+  {
+    file->readPages(claimed.front().first, claimed.back().first - claimed.front().first + 1, pages);
+  }
+  catch (...)
+  {
+    for (std::size_t i = 0; i < claimed.size(); i++)
+    {
+      hashTable->remove(file, claimed[i].first);
+      releaseFrame(claimed[i].second);
+    }
+    throw;
+  }
+
+  std::size_t next = 0;
+  for (std::size_t i = 0; i < claimed.size(); i++)
+  {
+    const PageId pageNo = claimed[i].first;
+    const FrameId frameNo = claimed[i].second;
+    while (next < pages.size() && pages[next].first < pageNo)
+      next++;
+    if (next == pages.size() || pages[next].first != pageNo)
+    {
+      // a free page, or the file is shorter than it was
+      hashTable->remove(file, pageNo);
+      releaseFrame(frameNo);
+      continue;
+    }
 
-    // set up the entry properly
-    bufDescTable[frameNo].Set(file, pageNo);
-    page = &bufPool[frameNo];
+    bufStats.diskreads++;
+    victimCache.erase(file, pageNo);
+    *bufPool[frameNo] = pages[next].second;
+    assignFrame(frameNo, file, pageNo);
+    BufDesc* tmpbuf = bufDescTable[frameNo];
+    tmpbuf->pinCnt = 0;
+    tmpbuf->prefetched = true;
+    policy->pageLoaded(frameNo, file, pageNo);
+    tmpbuf->latch.unlock();
+    loaded++;
+  }
+  return complete;
+}
 
-    // insert in the hash table
-    hashTable->insert(file, pageNo, frameNo);
+void BufMgr::cancelPrefetch(const File* file)
+{
+  std::unique_lock<std::mutex> lock(prefetchMutex);
+  for (std::deque<std::pair<File*, PageId> >::iterator it = prefetchQueue.begin(); it != prefetchQueue.end(); )
+  {
+    if (it->first == file)
+      it = prefetchQueue.erase(it);
+    else
+      ++it;
   }
+  prefetchIdle.wait(lock, [this, file] { return prefetchBusyFile != file; });
 }
 
+void BufMgr::prefetchLoop()
+{
+  std::unique_lock<std::mutex> lock(prefetchMutex);
+  while (true)
+  {
+    prefetchReady.wait(lock, [this] { return prefetchStopping || !prefetchQueue.empty(); });
+    if (prefetchStopping)
+      return;
+
+    // enter the resize gate before taking a request: a thread waiting for the
+    // request's file to be finished may itself be holding resize() up
+    lock.unlock();
+    resizeGate.enter();
+    lock.lock();
+    if (prefetchStopping || prefetchQueue.empty())
+    {
+      resizeGate.leave();
+      continue;
+    }
+
+    std::pair<File*, PageId> request = prefetchQueue.front();
+    prefetchQueue.pop_front();
+    prefetchBusyFile = request.first;
+    lock.unlock();
+
+    FrameId frameNo;
+    if (!hashTable->tryLookup(request.first, request.second, frameNo))
+    {
+      try
+      {
+        if (loadPage(request.first, request.second, false, frameNo) == PAGE_LOADED)
+          bufStats.prefetches++;
+      }
+      catch (const BadgerDbException &e)
+      {
+        // read-ahead is only a hint: pages past the end of the file and free
+        // pages are simply skipped, like a pool full of pinned pages
+      }
+    }
+
+    resizeGate.leave();
+    lock.lock();
+    prefetchBusyFile = NULL;
+    prefetchIdle.notify_all();
+  }
+}
 
-void BufMgr::unPinPage(File* file, const PageId pageNo, const bool dirty) 
+void BufMgr::unPinPage(File* file, const PageId pageNo, const bool dirty, const Lsn lsn) 
 {
+  SharedGate::Guard gate(resizeGate);
+
   // lookup in hashtable
   FrameId frameNo = 0;
   hashTable->lookup(file, pageNo, frameNo);
 
-  if (dirty == true) bufDescTable[frameNo].dirty = dirty;
+  BufDesc* tmpbuf = bufDescTable[frameNo];
+  std::lock_guard<std::mutex> guard(tmpbuf->latch);
+  if (dirty == true) markDirty(frameNo, lsn);
 
   // make sure the page is actually pinned
-  if (bufDescTable[frameNo].pinCnt == 0)
+  if (tmpbuf->pinCnt == 0)
   {
   	throw PageNotPinnedException(file->filename(), pageNo, frameNo);
   }
-  else bufDescTable[frameNo].pinCnt--;
+  else tmpbuf->pinCnt--;
+
+  if (tmpbuf->pinCnt == 0 && frameNo >= numBufs)
+    retireFrame(frameNo);
+}
+
+bool BufMgr::tryUnPinPage(File* file, const PageId pageNo, const bool dirty, const Lsn lsn)
+{
+  SharedGate::Guard gate(resizeGate);
+
+  FrameId frameNo = 0;
+  if (!hashTable->tryLookup(file, pageNo, frameNo))
+    return false;
+
+  // an unpinned page may have been evicted since the lookup
+  BufDesc* tmpbuf = bufDescTable[frameNo];
+  std::lock_guard<std::mutex> guard(tmpbuf->latch);
+  if (!tmpbuf->valid || tmpbuf->file != file || tmpbuf->pageNo != pageNo || tmpbuf->pinCnt == 0)
+    return false;
+
+  if (dirty == true) markDirty(frameNo, lsn);
+  tmpbuf->pinCnt--;
+  if (tmpbuf->pinCnt == 0 && frameNo >= numBufs)
+    retireFrame(frameNo);
+  return true;
+}
+
+void BufMgr::unPinFrame(const FrameId frameNo, const bool dirty, const Lsn lsn)
+{
+  SharedGate::Guard gate(resizeGate);
+
+  // the frame is pinned, so it still holds the page the handle was made for
+  BufDesc* tmpbuf = bufDescTable[frameNo];
+  std::lock_guard<std::mutex> guard(tmpbuf->latch);
+  if (dirty == true) markDirty(frameNo, lsn);
+
+  if (tmpbuf->pinCnt == 0)
+  {
+  	throw PageNotPinnedException(tmpbuf->file->filename(), tmpbuf->pageNo, frameNo);
+  }
+  else tmpbuf->pinCnt--;
+
+  if (tmpbuf->pinCnt == 0 && frameNo >= numBufs)
+    retireFrame(frameNo);
 }
 
-void BufMgr::allocPage(File* file, PageId &pageNo, Page*& page) 
+FrameId BufMgr::newPage(File* file, PageId &pageNo, const PageId near)
 {
   FrameId frameNo;
+  bufStats.accesses++;
 
-  // alloc a new frame
-  allocBuf(frameNo);
+  // alloc a new frame, it comes back latched
+  if (!allocBuf(frameNo))
+    throw BufferExceededException();
+  BufDesc* tmpbuf = bufDescTable[frameNo];
 
   // allocate a new page in the file
 	//std::cerr << "buffer data size:" << bufPool[frameNo].data_.length() << "\n";
-  bufPool[frameNo] = file->allocatePage(pageNo);
-  page = &bufPool[frameNo];
+  try
+  {
+    file->allocatePageInto(pageNo, *bufPool[frameNo], near);
+  }
+  catch (...)
+  {
+    releaseFrame(frameNo);
+    throw;
+  }
 
   // set up the entry properly
-  bufDescTable[frameNo].Set(file, pageNo);
+  assignFrame(frameNo, file, pageNo);
+  policy->pageLoaded(frameNo, file, pageNo);
 
   // insert in the hash table
   hashTable->insert(file, pageNo, frameNo);
+  tmpbuf->latch.unlock();
+  return frameNo;
+}
+
+void BufMgr::allocPage(File* file, PageId &pageNo, Page*& page, const PageId near) 
+{
+  SharedGate::Guard gate(resizeGate);
+  page = bufPool[newPage(file, pageNo, near)];
+}
+
+PageHandle BufMgr::allocPage(File* file, PageId &pageNo, const PageId near)
+{
+  SharedGate::Guard gate(resizeGate);
+  const FrameId frameNo = newPage(file, pageNo, near);
+  return PageHandle(this, frameNo, bufPool[frameNo]);
+}
+
+void BufMgr::unlatchFrames(const std::vector<FrameId>& frames)
+{
+  for (std::size_t i = 0; i < frames.size(); i++)
+    bufDescTable[frames[i]]->latch.unlock();
 }
 
 void BufMgr::flushFile(const File* file) 
 {
-  for (std::uint32_t i = 0; i < numBufs; i++)
+  SharedGate::Guard gate(resizeGate);
+  removeFile(file, true);
+}
+
+void BufMgr::evictFile(const File* file)
+{
+  SharedGate::Guard gate(resizeGate);
+  removeFile(file, false);
+}
+
+void BufMgr::removeFile(const File* file, const bool writeDirty)
+{
+  cancelPrefetch(file);
+
+  // latch all frames of the file first so their dirty pages can be handed to
+  // the file as one batch, which it writes sorted and coalesced. Latches are
+  // taken in frame order, so two threads doing this can not deadlock.
+  std::vector<FrameId> listed;
+  framesOfFile(file, listed);
+  std::sort(listed.begin(), listed.end());
+
+  std::vector<FrameId> frames;
+  std::vector<std::pair<PageId, const Page*> > dirtyPages;
+  Lsn maxLsn = 0;
+  for (std::size_t i = 0; i < listed.size(); i++)
 	{
-  	BufDesc* tmpbuf = &(bufDescTable[i]);
+  	BufDesc* tmpbuf = bufDescTable[listed[i]];
+  	tmpbuf->latch.lock();
   	if(tmpbuf->file && tmpbuf->valid == true && tmpbuf->file == file)
 		{
 	    if (tmpbuf->pinCnt > 0)
+	    {
+	      tmpbuf->latch.unlock();
+	      unlatchFrames(frames);
   			throw PagePinnedException(file->filename(), tmpbuf->pageNo, tmpbuf->frameNo);
+	    }
 
-	    if (tmpbuf->dirty == true)
-			{
-				//if ((status = tmpbuf->file->writePage(tmpbuf->pageNo, &(bufPool[i]))) != OK)
-				tmpbuf->file->writePage(tmpbuf->pageNo, bufPool[i]);
-				tmpbuf->dirty = false;
-    	}
-
-    	hashTable->remove(file,tmpbuf->pageNo);
-    	tmpbuf->Clear();
+	    frames.push_back(listed[i]);
+	    if (tmpbuf->dirty == true && writeDirty)
+	    {
+	      unswizzleChildren(listed[i]);
+	      dirtyPages.push_back(std::make_pair(tmpbuf->pageNo, bufPool[listed[i]]));
+	      maxLsn = std::max(maxLsn, tmpbuf->pageLsn);
+	    }
+	    continue;
   	}
 		else if (tmpbuf->valid == false && tmpbuf->file == file)
-  		throw BadBufferException(tmpbuf->frameNo, tmpbuf->dirty, tmpbuf->valid, tmpbuf->refbit);
+		{
+		  tmpbuf->latch.unlock();
+		  unlatchFrames(frames);
+  		throw BadBufferException(tmpbuf->frameNo, tmpbuf->dirty, tmpbuf->valid, false);
+		}
+  	// the frame was reused between listing and latching it
+  	tmpbuf->latch.unlock();
+  }
+
+  if (!dirtyPages.empty())
+  {
+    File* target = bufDescTable[frames.front()]->file;
+    try
+    {
+      flushLogTo(maxLsn);
+      target->writePages(dirtyPages);
+      target->sync();
+    }
+    catch (...)
+    {
+      unlatchFrames(frames);
+      throw;
+    }
+    bufStats.diskwrites += dirtyPages.size();
+  }
+
+  for (std::size_t i = 0; i < frames.size(); i++)
+  {
+  	BufDesc* tmpbuf = bufDescTable[frames[i]];
+    hashTable->remove(file, tmpbuf->pageNo);
+    clearFrame(frames[i]);
+    if (frames[i] < numBufs)
+      policy->frameFreed(frames[i]);
+    tmpbuf->latch.unlock();
+  }
+
+  // the File object may go away once the caller is done with it
+  victimCache.eraseFile(file);
+}
+
+void BufMgr::assignFrame(const FrameId frame, File* file, const PageId pageNo)
+{
+  BufDesc* tmpbuf = bufDescTable[frame];
+  tmpbuf->Set(file, pageNo);
+  tmpbuf->pinLsn = (log != NULL) ? log->endLsn() : 0;
+
+  // link the frame in at the head of the file's list
+  std::lock_guard<std::mutex> guard(fileFramesMutex);
+  std::unordered_map<const File*, FrameId>::iterator head = fileFrames.find(file);
+  tmpbuf->filePrev = NO_FRAME;
+  tmpbuf->fileNext = (head == fileFrames.end()) ? NO_FRAME : head->second;
+  if (tmpbuf->fileNext != NO_FRAME)
+    bufDescTable[tmpbuf->fileNext]->filePrev = frame;
+  fileFrames[file] = frame;
+
+  // frames of the same file share its counters; only the first one needs the lookup by name
+  tmpbuf->counters = (tmpbuf->fileNext != NO_FRAME) ? bufDescTable[tmpbuf->fileNext]->counters
+                                                     : bufStats.countersOf(file);
+}
+
+void BufMgr::clearFrame(const FrameId frame)
+{
+  BufDesc* tmpbuf = bufDescTable[frame];
+
+  // drop the swizzled references to and from the page
+  unswizzleChildren(frame);
+  if (tmpbuf->swizzleSlot != NULL)
+  {
+    std::lock_guard<std::mutex> guard(swizzleMutex);
+    if (tmpbuf->swizzleSlot != NULL)
+      unswizzleLocked(frame);
+  }
+
+  if (tmpbuf->valid)
+  {
+    // unlink the frame from its file's list
+    std::lock_guard<std::mutex> guard(fileFramesMutex);
+    if (tmpbuf->filePrev != NO_FRAME)
+      bufDescTable[tmpbuf->filePrev]->fileNext = tmpbuf->fileNext;
+    else if (tmpbuf->fileNext != NO_FRAME)
+      fileFrames[tmpbuf->file] = tmpbuf->fileNext;
+    else
+      fileFrames.erase(tmpbuf->file);
+    if (tmpbuf->fileNext != NO_FRAME)
+      bufDescTable[tmpbuf->fileNext]->filePrev = tmpbuf->filePrev;
+    tmpbuf->filePrev = tmpbuf->fileNext = NO_FRAME;
+  }
+  markClean(frame);
+  tmpbuf->Clear();
+}
+
+void BufMgr::unswizzleChildren(const FrameId parent)
+{
+  if (bufDescTable[parent]->swizzledChildren == 0)
+    return;
+  std::lock_guard<std::mutex> guard(swizzleMutex);
+  for (FrameId i = 0; i < bufDescTable.size() && bufDescTable[parent]->swizzledChildren > 0; i++)
+  {
+    if (bufDescTable[i]->swizzleSlot != NULL && bufDescTable[i]->swizzleParent == parent)
+      unswizzleLocked(i);
   }
 }
 
+void BufMgr::unswizzleLocked(const FrameId frame)
+{
+  BufDesc* tmpbuf = bufDescTable[frame];
+  PageId* slot = tmpbuf->swizzleSlot.exchange(NULL);
+  __atomic_store_n(slot, tmpbuf->swizzledPageNo, __ATOMIC_RELEASE);
+  bufDescTable[tmpbuf->swizzleParent]->swizzledChildren--;
+  tmpbuf->swizzleParent = NO_FRAME;
+  tmpbuf->swizzledPageNo = Page::INVALID_NUMBER;
+}
+
+void BufMgr::markDirty(const FrameId frame, const Lsn lsn)
+{
+  BufDesc* tmpbuf = bufDescTable[frame];
+  tmpbuf->pageLsn = std::max(tmpbuf->pageLsn, lsn);
+  // the page is pinned, and its changes were logged after it was; the one
+  // passed here may not be the first of them
+  if (lsn != 0 && tmpbuf->recLsn == 0)
+    tmpbuf->recLsn = tmpbuf->pinLsn + 1;
+  if (tmpbuf->dirty)
+    return;
+  std::lock_guard<std::mutex> guard(dirtyTableMutex);
+  tmpbuf->dirty = true;
+  tmpbuf->firstDirtied = ++dirtySeq;
+  dirtyTable.insert(std::make_pair(tmpbuf->firstDirtied, frame));
+}
+
+void BufMgr::markClean(const FrameId frame)
+{
+  BufDesc* tmpbuf = bufDescTable[frame];
+  if (!tmpbuf->dirty)
+    return;
+  std::lock_guard<std::mutex> guard(dirtyTableMutex);
+  dirtyTable.erase(std::make_pair(tmpbuf->firstDirtied, frame));
+  tmpbuf->dirty = false;
+  tmpbuf->firstDirtied = 0;
+  tmpbuf->recLsn = 0;
+}
+
+void BufMgr::pinFrame(const FrameId frame)
+{
+  BufDesc* tmpbuf = bufDescTable[frame];
+  if (tmpbuf->pinCnt++ == 0 && log != NULL)
+    tmpbuf->pinLsn = log->endLsn();
+}
+
+void BufMgr::framesOfFile(const File* file, std::vector<FrameId>& frames)
+{
+  std::lock_guard<std::mutex> guard(fileFramesMutex);
+  std::unordered_map<const File*, FrameId>::iterator head = fileFrames.find(file);
+  if (head == fileFrames.end())
+    return;
+  for (FrameId i = head->second; i != NO_FRAME; i = bufDescTable[i]->fileNext)
+    frames.push_back(i);
+}
+
 void BufMgr::disposePage(File* file, const PageId pageNo)
 {
+  SharedGate::Guard gate(resizeGate);
+
 	//Deallocate from file altogether
   //See if it is in the buffer pool
   FrameId frameNo = 0;
+  cancelPrefetch(file);
   hashTable->lookup(file, pageNo, frameNo);
 
-	// clear the page
-	bufDescTable[frameNo].Clear();
+  {
+    BufDesc* tmpbuf = bufDescTable[frameNo];
+    std::lock_guard<std::mutex> guard(tmpbuf->latch);
+    if (tmpbuf->valid && tmpbuf->file == file && tmpbuf->pageNo == pageNo)
+    {
+      // clear the page
+      clearFrame(frameNo);
+      if (frameNo < numBufs)
+        policy->frameFreed(frameNo);
 
-	hashTable->remove(file, pageNo);
+      hashTable->remove(file, pageNo);
+    }
+  }
 
   // deallocate it in the file	
+  victimCache.erase(file, pageNo);
   file->deletePage(pageNo);
 }
 
+void BufMgr::dumpStats(std::ostream& os)
+{
+  SharedGate::Guard gate(resizeGate);
+  os << "{\"frames\":" << numBufs << ",\"policy\":\"" << policy->name() << "\",\"stats\":";
+  bufStats.snapshot().dump(os);
+  os << "}";
+}
+
+void BufMgr::startBgWriter(const std::uint32_t pagesPerRound, const std::uint32_t intervalMs)
+{
+  bgWriterPages = pagesPerRound;
+  bgWriter.start(std::bind(&BufMgr::bgWriterRound, this), intervalMs);
+}
+
+void BufMgr::setBgWriterRate(const std::uint32_t pagesPerRound, const std::uint32_t intervalMs)
+{
+  bgWriterPages = pagesPerRound;
+  bgWriter.setInterval(intervalMs);
+}
+
+void BufMgr::stopBgWriter()
+{
+  bgWriter.stop();
+}
+
+void BufMgr::startCheckpointer(const std::uint32_t pagesPerRound, const std::uint32_t intervalMs)
+{
+  checkpointerPages = pagesPerRound;
+  checkpointer.start(std::bind(&BufMgr::checkpointRound, this), intervalMs);
+}
+
+void BufMgr::setCheckpointRate(const std::uint32_t pagesPerRound, const std::uint32_t intervalMs)
+{
+  checkpointerPages = pagesPerRound;
+  checkpointer.setInterval(intervalMs);
+}
+
+void BufMgr::stopCheckpointer()
+{
+  checkpointer.stop();
+}
+
+void BufMgr::checkpointRound()
+{
+  try
+  {
+    checkpoint(checkpointerPages);
+  }
+  catch (const BadgerDbException &e)
+  {
+    // the pages stay dirty; flushFile() and the miss path will report the error
+  }
+}
+
+std::uint32_t BufMgr::checkpoint(const std::uint32_t maxPages)
+{
+  SharedGate::Guard gate(resizeGate);
+
+  // the dirty pages, those that have been dirty the longest first
+  std::vector<std::pair<std::uint64_t, FrameId> > oldest;
+  {
+    std::lock_guard<std::mutex> guard(dirtyTableMutex);
+    oldest.assign(dirtyTable.begin(), dirtyTable.end());
+  }
+
+  // latch the first maxPages of them that nobody has pinned. A pinned page may
+  // be in the middle of a change, so only unpinned ones make a consistent
+  // image. Frames that are busy or have been cleaned or redirtied since are
+  // left out too. The latches stay held until the pages are on disk, so nobody
+  // can pin a page and change it, or evict it and read the old version back in.
+  std::vector<FrameId> latched;
+  for (std::size_t i = 0; i < oldest.size() && latched.size() < maxPages; i++)
+  {
+    BufDesc* tmpbuf = bufDescTable[oldest[i].second];
+    if (!tmpbuf->latch.try_lock())
+      continue;
+    if (!tmpbuf->valid || !tmpbuf->dirty || tmpbuf->firstDirtied != oldest[i].first || tmpbuf->pinCnt > 0)
+    {
+      tmpbuf->latch.unlock();
+      continue;
+    }
+    unswizzleChildren(oldest[i].second);
+    latched.push_back(oldest[i].second);
+  }
+
+  // one sorted batch and one sync per file
+  std::map<File*, std::vector<std::pair<PageId, const Page*> > > dirtyPages;
+  Lsn maxLsn = 0;
+  for (std::size_t i = 0; i < latched.size(); i++)
+  {
+    BufDesc* tmpbuf = bufDescTable[latched[i]];
+    dirtyPages[tmpbuf->file].push_back(std::make_pair(tmpbuf->pageNo, bufPool[latched[i]]));
+    maxLsn = std::max(maxLsn, tmpbuf->pageLsn);
+  }
+  try
+  {
+    flushLogTo(maxLsn);
+    for (std::map<File*, std::vector<std::pair<PageId, const Page*> > >::iterator it = dirtyPages.begin();
+         it != dirtyPages.end(); ++it)
+    {
+      it->first->writePages(it->second);
+      it->first->sync();
+    }
+  }
+  catch (...)
+  {
+    unlatchFrames(latched);
+    throw;
+  }
+
+  for (std::size_t i = 0; i < latched.size(); i++)
+    markClean(latched[i]);
+  unlatchFrames(latched);
+
+  bufStats.diskwrites += latched.size();
+  bufStats.checkpointWrites += latched.size();
+
+  truncateLog();
+  return latched.size();
+}
+
+void BufMgr::truncateLog()
+{
+  if (log == NULL)
+    return;
+
+  // changes logged from here on are past the cut whatever frame they land in.
+  // One frame at a time is enough: a page that moves or gets pinned after its
+  // frame was looked at is only changed by records logged after this point.
+  Lsn cut = log->endLsn();
+  for (FrameId i = 0; i < bufDescTable.size(); i++)
+  {
+    BufDesc* tmpbuf = bufDescTable[i];
+    std::lock_guard<std::mutex> guard(tmpbuf->latch);
+    if (!tmpbuf->valid)
+      continue;
+    if (tmpbuf->pinCnt > 0)
+      cut = std::min(cut, tmpbuf->pinLsn);
+    if (tmpbuf->dirty && tmpbuf->recLsn != 0)
+      cut = std::min(cut, tmpbuf->recLsn - 1);
+  }
+
+  const Lsn point = log->truncationPoint(cut);
+  if (point == 0)
+    return;
+  File::syncAll();
+  log->truncate(point);
+}
+
+std::vector<DirtyPageEntry> BufMgr::dirtyPageTable()
+{
+  SharedGate::Guard gate(resizeGate);
+
+  std::vector<std::pair<std::uint64_t, FrameId> > entries;
+  {
+    std::lock_guard<std::mutex> guard(dirtyTableMutex);
+    entries.assign(dirtyTable.begin(), dirtyTable.end());
+  }
+
+  // the page of each entry is read under the frame latch, which the table's mutex can not be held with
+  std::vector<DirtyPageEntry> table;
+  for (std::size_t i = 0; i < entries.size(); i++)
+  {
+    BufDesc* tmpbuf = bufDescTable[entries[i].second];
+    std::lock_guard<std::mutex> guard(tmpbuf->latch);
+    if (tmpbuf->valid && tmpbuf->dirty && tmpbuf->firstDirtied == entries[i].first)
+    {
+      DirtyPageEntry entry = {tmpbuf->file, tmpbuf->pageNo, tmpbuf->firstDirtied};
+      table.push_back(entry);
+    }
+  }
+  return table;
+}
+
+void BufMgr::setLog(LogManager* log)
+{
+  SharedGate::Guard gate(resizeGate);
+  this->log = log;
+}
+
+void BufMgr::setVictimCacheSize(const std::size_t bytes)
+{
+  SharedGate::Guard gate(resizeGate);
+  victimCache.setBudget(bytes);
+}
+
+void BufMgr::flushLogTo(const Lsn lsn)
+{
+  if (log != NULL && lsn != 0)
+    log->flush(lsn);
+}
+
+void BufMgr::bgWriterRound()
+{
+  SharedGate::Guard gate(resizeGate);
+  std::uint32_t budget = bgWriterPages;
+  std::vector<FrameId> candidates;
+  policy->nextVictims(candidates, 2 * budget);
+
+  for (std::size_t i = 0; i < candidates.size() && budget > 0; i++)
+  {
+    BufDesc* tmpbuf = bufDescTable[candidates[i]];
+
+    // frames that are busy right now are left for the next round
+    if (!tmpbuf->latch.try_lock())
+      continue;
+    std::lock_guard<std::mutex> guard(tmpbuf->latch, std::adopt_lock);
+
+    if (tmpbuf->valid && tmpbuf->dirty && tmpbuf->pinCnt == 0)
+    {
+      try
+      {
+        unswizzleChildren(candidates[i]);
+        flushLogTo(tmpbuf->pageLsn);
+        tmpbuf->file->writePage(tmpbuf->pageNo, *bufPool[candidates[i]]);
+      }
+      catch (const BadgerDbException &e)
+      {
+        // leave the page dirty; the miss path will retry the write and report the error
+        continue;
+      }
+      markClean(candidates[i]);
+      bufStats.diskwrites++;
+      bufStats.bgwrites++;
+      budget--;
+    }
+  }
+}
+
 void BufMgr::printSelf(void) 
 {
+  SharedGate::Guard gate(resizeGate);
   BufDesc* tmpbuf;
 	int validFrames = 0;
   
   for (std::uint32_t i = 0; i < numBufs; i++)
 	{
-  	tmpbuf = &(bufDescTable[i]);
+  	tmpbuf = bufDescTable[i];
 		std::cout << "FrameNo:" << i << " ";
 		tmpbuf->Print();
 
@@ -246,4 +1425,70 @@ void BufMgr::printSelf(void)
 	std::cout << "Total Number of Valid Frames:" << validFrames << "\n";
 }
 
+//----------------------------------------
+// PageHandle
+//----------------------------------------
+
+PageHandle::PageHandle()
+	: bufMgr(NULL), frameNo(0), pagePtr(NULL), dirty(false), lsn(0)
+{
+}
+
+PageHandle::PageHandle(BufMgr* bufMgr, const FrameId frameNo, Page* page)
+	: bufMgr(bufMgr), frameNo(frameNo), pagePtr(page), dirty(false), lsn(0)
+{
+}
+
+PageHandle::PageHandle(PageHandle&& other)
+	: bufMgr(other.bufMgr), frameNo(other.frameNo), pagePtr(other.pagePtr), dirty(other.dirty), lsn(other.lsn)
+{
+  other.bufMgr = NULL;
+  other.pagePtr = NULL;
+  other.dirty = false;
+  other.lsn = 0;
+}
+
+PageHandle& PageHandle::operator=(PageHandle&& other)
+{
+  if (this != &other)
+  {
+    release();
+    bufMgr = other.bufMgr;
+    frameNo = other.frameNo;
+    pagePtr = other.pagePtr;
+    dirty = other.dirty;
+    lsn = other.lsn;
+    other.bufMgr = NULL;
+    other.pagePtr = NULL;
+    other.dirty = false;
+    other.lsn = 0;
+  }
+  return *this;
+}
+
+PageHandle::~PageHandle()
+{
+  try
+  {
+    release();
+  }
+  catch (...)
+  {
+    // destructors must not throw, and the pin a handle holds can not go away
+  }
+}
+
+void PageHandle::release()
+{
+  if (bufMgr == NULL)
+    return;
+
+  BufMgr* owner = bufMgr;
+  bufMgr = NULL;
+  pagePtr = NULL;
+  owner->unPinFrame(frameNo, dirty, lsn);
+  dirty = false;
+  lsn = 0;
+}
+
 }
@@ -9,7 +9,23 @@
 
 #include "file.h"
 #include "bufHashTbl.h"
+#include "page_pool.h"
+#include "replacement_policy.h"
+#include "periodic_task.h"
+#include "shared_gate.h"
+#include "buffer_stats.h"
+#include "log_manager.h"
+#include "victim_cache.h"
 #include <iostream>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 
 namespace badgerdb {
 
@@ -18,6 +34,97 @@ namespace badgerdb {
 */
 class BufMgr;
 
+/**
+* Frame number used to end the per-file frame lists
+*/
+static const FrameId NO_FRAME = ~FrameId(0);
+
+/**
+* @brief A pin on a page in the buffer pool, as returned by BufMgr::readPage() and BufMgr::allocPage().
+*
+* The handle remembers the frame the page is in, so releasing it unpins the page without a hash table lookup.
+* It unpins the page when it is released, reassigned or destroyed, marking it dirty if markDirty() was called.
+* Handles can be moved but not copied, so there is always exactly one owner of the pin.
+*/
+class PageHandle {
+
+	friend class BufMgr;
+
+ public:
+	/**
+   * Constructs a handle that holds no page
+	 */
+  PageHandle();
+
+  PageHandle(PageHandle&& other);
+  PageHandle& operator=(PageHandle&& other);
+
+	/**
+   * Unpins the page if the handle still holds it
+	 */
+  ~PageHandle();
+
+	/**
+   * Returns the pinned page, NULL if the handle holds none
+	 */
+  Page* page() const { return pagePtr; }
+  Page* operator->() const { return pagePtr; }
+  Page& operator*() const { return *pagePtr; }
+
+	/**
+   * Returns true if the handle holds a page
+	 */
+  bool valid() const { return pagePtr != NULL; }
+
+	/**
+   * Has the page written back when it is unpinned.
+   *
+   * @param lsn   LSN of the log record of the change, if it was logged; the page is not written before the log
+   *              is on disk up to the largest LSN given
+	 */
+  void markDirty(const Lsn lsn = 0)
+  {
+    dirty = true;
+    if (lsn > this->lsn)
+      this->lsn = lsn;
+  }
+
+	/**
+   * Unpins the page now. Does nothing if the handle holds no page.
+	 */
+  void release();
+
+ private:
+  PageHandle(BufMgr* bufMgr, const FrameId frameNo, Page* page);
+  PageHandle(const PageHandle&);
+  PageHandle& operator=(const PageHandle&);
+
+	/**
+   * Buffer manager holding the pin, NULL if the handle holds none
+	 */
+  BufMgr* bufMgr;
+
+	/**
+   * Frame the page is pinned in
+	 */
+  FrameId frameNo;
+
+	/**
+   * The pinned page
+	 */
+  Page* pagePtr;
+
+	/**
+   * True if the page is to be marked dirty when unpinned
+	 */
+  bool dirty;
+
+	/**
+   * Largest LSN passed to markDirty(), 0 if none
+	 */
+  Lsn lsn;
+};
+
 /**
 * @brief Class for maintaining information about buffer pool frames
 */
@@ -57,9 +164,72 @@ class BufDesc {
   bool valid;
 
 	/**
-   * Has this buffer frame been reference recently
+   * True if the page was brought in by prefetch() and has not been read since
+	 */
+  bool prefetched;
+
+	/**
+   * Statistics counters of the page's file, set while the frame holds a page
 	 */
-  bool refbit;
+  BufCounters* counters;
+
+	/**
+   * When the page went from clean to dirty, as a value of the buffer manager's dirty sequence; 0 while clean.
+   * Together with the frame number this is the page's key in the dirty page table.
+	 */
+  std::uint64_t firstDirtied;
+
+	/**
+   * LSN of the latest logged change to the page, 0 if none. The log must be on disk up to here before the page
+   * is written.
+	 */
+  Lsn pageLsn;
+
+	/**
+   * Lowest LSN the first logged change to the page since it was last clean can have, 0 if there is none: one
+   * past the end of the log when the page was pinned for the change. The log is needed from there on to bring
+   * the page on disk up to date.
+	 */
+  Lsn recLsn;
+
+	/**
+   * End of the log when the page was last pinned by nobody else. While the page stays pinned, changes logged
+   * for it after this point may not have been handed to the buffer manager yet.
+	 */
+  Lsn pinLsn;
+
+	/**
+   * Slot in a parent page that holds a swizzled reference to this frame, NULL if there is none. Set and cleared
+   * under the buffer manager's swizzle mutex, and also under the latch except when the parent drops its
+   * references, hence atomic.
+	 */
+  std::atomic<PageId*> swizzleSlot;
+
+	/**
+   * While swizzleSlot is set: the page number the slot held before it was swizzled, and the frame of the parent
+   * page. Guarded by the swizzle mutex.
+	 */
+  PageId swizzledPageNo;
+  FrameId swizzleParent;
+
+	/**
+   * Number of references in this page that are swizzled. A page with swizzled references is never evicted.
+	 */
+  std::atomic<std::uint32_t> swizzledChildren;
+
+	/**
+   * Neighbours in the list of frames holding pages of the same file. Maintained by the buffer manager under its
+   * directory mutex rather than the latch, NO_FRAME at either end.
+	 */
+  FrameId filePrev;
+  FrameId fileNext;
+
+	/**
+   * Per-frame latch. Guards every other member of the descriptor, and is held
+   * for the whole time a page is being read into or written out of the frame,
+   * so threads that find the page in the hash table wait for the I/O to finish.
+	 */
+  std::mutex latch;
 
 	/**
    * Initialize buffer frame for a new user
@@ -70,8 +240,13 @@ class BufDesc {
 		file = NULL;
 		pageNo = Page::INVALID_NUMBER;
     dirty = false;
-    refbit = false;
 		valid = false;
+		prefetched = false;
+		counters = NULL;
+		firstDirtied = 0;
+		pageLsn = 0;
+		recLsn = 0;
+		pinLsn = 0;
   };
 
 	/**
@@ -88,7 +263,7 @@ class BufDesc {
     pinCnt = 1;
     dirty = false;
     valid = true;
-    refbit = true;
+    prefetched = false;
   }
 
   void Print()
@@ -103,8 +278,7 @@ class BufDesc {
 
 		std::cout << "valid:" << valid << " ";
 		std::cout << "pinCnt:" << pinCnt << " ";
-		std::cout << "dirty:" << dirty << " ";
-		std::cout << "refbit:" << refbit << "\n";
+		std::cout << "dirty:" << dirty << "\n";
   }
 
 	/**
@@ -113,61 +287,50 @@ class BufDesc {
   BufDesc()
 	{
   	Clear();
+  	filePrev = fileNext = NO_FRAME;
+  	swizzleSlot = NULL;
+  	swizzledPageNo = Page::INVALID_NUMBER;
+  	swizzleParent = NO_FRAME;
+  	swizzledChildren = 0;
   }
 };
 
 
 /**
-* @brief Class to maintain statistics of buffer usage 
+* @brief An entry of the dirty page table, as returned by BufMgr::dirtyPageTable().
 */
-struct BufStats
+struct DirtyPageEntry
 {
-	/**
-   * Total number of accesses to buffer pool
-	 */
-  int accesses;
-
-	/**
-   * Number of pages read from disk (including allocs)
-	 */
-  int diskreads;
-
-	/**
-   * Number of pages written back to disk
-	 */
-  int diskwrites;
+  const File* file;
+  PageId pageNo;
 
 	/**
-   * Clear all values 
-	 */
-  void clear()
-  {
-		accesses = diskreads = diskwrites = 0;
-  }
-      
-	/**
-   * Constructor of BufStats class 
+   * When the page went from clean to dirty, as a position in the sequence of all such transitions
 	 */
-  BufStats()
-  {
-		clear();
-  }
+  std::uint64_t firstDirtied;
 };
 
-
 /**
 * @brief The central class which manages the buffer pool including frame allocation and deallocation to pages in the file 
+*
+* All public methods may be called concurrently from multiple threads. Each frame is protected by the latch in its
+* BufDesc and the hash table is latched per stripe, so there is no pool-wide lock on the readPage()/unPinPage()
+* path. Which frame is reused on a miss is decided by a ReplacementPolicy chosen at construction. The only
+* pool-wide synchronization is a SharedGate that lets resize() wait for the other calls to drain.
 */
 class BufMgr 
 {
+	friend class PageHandle;
+
  private:
 	/**
-   * Current position of clockhand in our buffer pool
+   * Replacement policy choosing victim frames
 	 */
-  FrameId clockHand;
+  ReplacementPolicy* policy;
 
 	/**
-   * Number of frames in the buffer pool
+   * Number of frames in the buffer pool. Frames past it that still hold a page were pinned when the pool was
+   * shrunk; they are unknown to the replacement policy and give up their page when it is unpinned.
 	 */
   std::uint32_t numBufs;
 	
@@ -177,9 +340,41 @@ class BufMgr
   BufHashTbl *hashTable;
 
 	/**
-   * Array of BufDesc objects to hold information corresponding to every frame allocation from 'bufPool' (the buffer pool)
+   * BufDesc objects holding information corresponding to every frame of the buffer pool, indexed by frame number
+	 */
+  std::vector<BufDesc*> bufDescTable;
+
+	/**
+   * Actual buffer pool from which frames are allocated: the memory of every frame, indexed by frame number
+	 */
+  std::vector<Page*> bufPool;
+
+	/**
+   * @brief A block of frames allocated together. The constructor allocates the first one and every resize() that
+   * grows the pool beyond the frames already allocated adds another, so frames never move while the pool exists.
+	 */
+  struct FrameChunk {
+    PagePool* pages;
+    BufDesc* descs;
+    FrameId first;
+    std::uint32_t count;
+  };
+
+	/**
+   * Chunks backing the frames, in frame order. bufDescTable and bufPool cover all of them, which may be more frames
+   * than numBufs after the pool has shrunk.
 	 */
-  BufDesc *bufDescTable;
+  std::vector<FrameChunk> chunks;
+
+	/**
+   * How the memory of new chunks is allocated
+	 */
+  PoolAllocation poolAllocation;
+
+	/**
+   * Every public method holds this gate open while it runs; resize() closes it
+	 */
+  SharedGate resizeGate;
 
 	/**
    * Maintains Buffer pool usage statistics 
@@ -187,31 +382,369 @@ class BufMgr
   BufStats bufStats;
 
 	/**
-   * Advance clock to next frame in the buffer pool
+   * Compressed copies of evicted pages, checked on a miss before the disk; disabled until setVictimCacheSize()
+	 */
+  VictimCache victimCache;
+
+	/**
+   * Background writer thread, see startBgWriter()
+	 */
+  PeriodicTask bgWriter;
+
+	/**
+   * Maximum number of pages the background writer cleans per round
+	 */
+  std::atomic<std::uint32_t> bgWriterPages;
+
+	/**
+	 * One round of the background writer: writes out dirty, unpinned pages among the frames the replacement
+	 * policy will pick next.
+	 */
+  void bgWriterRound();
+
+	/**
+   * Dirty page table: (firstDirtied, frame) of every dirty frame, so the pages that have been dirty longest
+   * come first
+	 */
+  std::set<std::pair<std::uint64_t, FrameId> > dirtyTable;
+
+	/**
+   * Number of clean-to-dirty transitions so far; each one is recorded in the page's firstDirtied
+	 */
+  std::uint64_t dirtySeq;
+
+	/**
+   * Protects dirtyTable and dirtySeq. Taken after a frame latch, never before one.
+	 */
+  std::mutex dirtyTableMutex;
+
+	/**
+   * Background checkpointer thread, see startCheckpointer()
+	 */
+  PeriodicTask checkpointer;
+
+	/**
+   * Maximum number of pages the checkpointer writes per round
+	 */
+  std::atomic<std::uint32_t> checkpointerPages;
+
+	/**
+   * Write-ahead log whose records must reach the disk before the pages they describe, NULL if none. Not owned.
+	 */
+  LogManager* log;
+
+	/**
+	 * Enforces the write-ahead rule before pages are written: flushes the log up to the given LSN, the largest
+	 * page LSN among the pages about to be written. Does nothing without a log or for pages with no logged change.
+	 *
+	 * @throws  LogIOException If the log can not be flushed; the pages must then not be written
+	 */
+  void flushLogTo(const Lsn lsn);
+
+	/**
+	 * Cuts off the front of the log, up to the oldest change it still has to redo: the first logged change of
+	 * every dirty page, and for a pinned page whatever was logged since it was pinned, which may not have reached
+	 * the buffer manager yet. The files are synced first, so pages written by evictions and the background writer
+	 * are on disk too. Does nothing without a log or while cutting it would not free at least half of it.
+	 *
+	 * @throws  FileIOException If a file can not be synced
+	 * @throws  LogIOException  If the log can not be rewritten
+	 */
+  void truncateLog();
+
+	/**
+	 * Adds a pin to a latched frame, noting the end of the log if it was unpinned.
+	 *
+	 * @param frame   	Frame whose latch the caller holds
+	 */
+  void pinFrame(const FrameId frame);
+
+	/**
+	 * One round of the checkpointer: checkpoint() with the configured budget, leaving pages that can not be
+	 * written dirty for the next round.
+	 */
+  void checkpointRound();
+
+	/**
+	 * Marks the page in a latched frame dirty, entering it in the dirty page table if it was clean.
+	 *
+	 * @param frame   	Frame whose latch the caller holds
+	 * @param lsn			LSN of the logged change to the page, 0 if none; raises the page LSN
+	 */
+  void markDirty(const FrameId frame, const Lsn lsn);
+
+	/**
+	 * Marks the page in a latched frame clean and removes it from the dirty page table.
+	 *
+	 * @param frame   	Frame whose latch the caller holds
+	 */
+  void markClean(const FrameId frame);
+
+	/**
+   * Pages waiting to be read by the prefetcher thread
+	 */
+  std::deque<std::pair<File*, PageId> > prefetchQueue;
+
+	/**
+   * Prefetcher thread, started by the first call to prefetch()
+	 */
+  std::thread prefetcher;
+
+	/**
+   * Protects prefetchQueue, prefetchStopping and prefetchBusyFile
+	 */
+  std::mutex prefetchMutex;
+
+	/**
+   * Signalled when requests are queued or the prefetcher is to stop
+	 */
+  std::condition_variable prefetchReady;
+
+	/**
+   * Signalled when the prefetcher finishes a request
+	 */
+  std::condition_variable prefetchIdle;
+
+	/**
+   * Set to make the prefetcher thread exit
+	 */
+  bool prefetchStopping;
+
+	/**
+   * File of the request the prefetcher is working on, NULL if none
+	 */
+  const File* prefetchBusyFile;
+
+	/**
+	 * Body of the prefetcher thread: reads queued pages into unpinned frames.
+	 */
+  void prefetchLoop();
+
+	/**
+	 * Drops queued prefetches for the file and waits until the prefetcher is not reading from it, so the file
+	 * can be closed.
+	 *
+	 * @param file   	File object
+	 */
+  void cancelPrefetch(const File* file);
+
+	/**
+   * Head of the list of resident frames of each file, threaded through BufDesc::fileNext
+	 */
+  std::unordered_map<const File*, FrameId> fileFrames;
+
+	/**
+   * Protects fileFrames and the list links in the descriptors. Taken after a frame latch, never before one.
+	 */
+  std::mutex fileFramesMutex;
+
+	/**
+	 * Assigns the latched frame to a page and enters it in its file's frame list.
+	 *
+	 * @param frame		Frame number, latched by the caller
+	 * @param file   	File object
+	 * @param pageNo	Page number in the file
 	 */
-  void advanceClock()
+  void assignFrame(const FrameId frame, File* file, const PageId pageNo);
+
+	/**
+	 * Clears the latched frame, removing it from its file's frame list if it held a page.
+	 *
+	 * @param frame		Frame number, latched by the caller
+	 */
+  void clearFrame(const FrameId frame);
+
+	/**
+	 * Protects the swizzle members of all frame descriptors. Taken after a frame latch, never before one.
+	 */
+  std::mutex swizzleMutex;
+
+	/**
+	 * Restores the references in the page of the given frame that are swizzled to plain page numbers, so the page
+	 * can be written or dropped.
+	 *
+	 * @param parent	Frame whose latch the caller holds, or that is pinned by the caller
+	 */
+  void unswizzleChildren(const FrameId parent);
+
+	/**
+	 * Restores the slot that refers to the given frame to the page number it held. The caller holds the swizzle
+	 * mutex, and the frame's swizzleSlot is set.
+	 */
+  void unswizzleLocked(const FrameId frame);
+
+	/**
+	 * Lists the frames currently holding pages of the file. The frames are not latched, so the caller must check
+	 * each one again after latching it.
+	 *
+	 * @param file   	File object
+	 * @param frames	Vector the frame numbers are appended to
+	 */
+  void framesOfFile(const File* file, std::vector<FrameId>& frames);
+
+	/**
+	 * Removes all pages of the file from the buffer pool, optionally writing the dirty ones first.
+	 *
+	 * @param file   			File object
+	 * @param writeDirty	Whether dirty pages are written to the file before they are dropped
+	 */
+  void removeFile(const File* file, const bool writeDirty);
+
+	/**
+	 * Allocates count more frames as a new chunk, numbered after the frames already allocated. Does not change
+	 * numBufs.
+	 *
+	 * @param count		Number of frames to add
+	 */
+  void addChunk(const std::uint32_t count);
+
+	/**
+	 * Replaces the hash table by one sized for numBufs frames holding the pages currently in the pool.
+	 */
+  void rebuildHashTable();
+
+	/**
+	 * Writes the dirty pages among the given frames, one sorted batch and one sync per file, and marks them clean.
+	 *
+	 * @param frames	Frames to write, latched by the caller or otherwise not in use
+	 */
+  void writeDirtyFrames(const std::vector<FrameId>& frames);
+
+	/**
+	 * Pins the given page, reading it in if it is not in the buffer pool.
+	 *
+	 * @param file   	File object
+	 * @param pageNo	Page number in the file
+	 * @param frameNo	Frame holding the page returned via this variable
+	 * @return  False if the page is not resident and every frame is pinned
+	 */
+  bool pinPage(File* file, const PageId pageNo, FrameId& frameNo);
+
+	/**
+	 * Allocates a new page in the file and pins it in a frame.
+	 *
+	 * @param file   	File object
+	 * @param pageNo	The number assigned to the page in the file is returned via this reference
+	 * @param near		Page to place the new one next to in the file, if possible
+	 * @return  Frame holding the page
+	 */
+  FrameId newPage(File* file, PageId &pageNo, const PageId near);
+
+	/**
+	 * Unpins the page in the given frame, for PageHandle.
+	 *
+	 * @param frameNo	Frame holding the page
+	 * @param dirty		True if the page needs to be marked dirty
+	 * @param lsn			LSN of the logged change to the page, 0 if none
+   * @throws  PageNotPinnedException If the page is not pinned
+	 */
+  void unPinFrame(const FrameId frameNo, const bool dirty, const Lsn lsn);
+
+	/**
+	 * Releases the latches of the given frames.
+	 *
+	 * @param frames	Frames whose latches the caller holds
+	 */
+  void unlatchFrames(const std::vector<FrameId>& frames);
+
+	/**
+	 * Outcome of loadPage()
+	 */
+  enum LoadStatus
   {
-		clockHand = (clockHand + 1) % numBufs;
-  }
+    PAGE_LOADED,		/* The page was read into a new frame */
+    PAGE_CLAIMED,		/* Another thread claimed the page first; nothing was loaded */
+    NO_FREE_FRAME		/* Every frame is pinned */
+  };
+
+	/**
+	 * Reads a page that is not in the buffer pool into a newly allocated frame and enters it in the hash table.
+	 *
+	 * @param file   	File object
+	 * @param pageNo	Page number in the file
+	 * @param pin			Whether the page is pinned for the caller; prefetched pages are loaded unpinned
+	 * @param frameNo	Frame the page was loaded into returned via this variable
+	 * @return  Whether the page was loaded, and why not if it was not
+	 */
+  LoadStatus loadPage(File* file, const PageId pageNo, const bool pin, FrameId& frameNo);
+
+	/**
+	 * Latches the frame if it holds no page or an unpinned one. Used by the replacement policy to test candidates.
+	 *
+	 * @param frame   	Frame to test
+	 * @return  True, with the frame latched, if the frame can be reused
+	 */
+  bool latchIfEvictable(const FrameId frame);
+
+	/**
+	 * Clears a latched frame that was allocated but could not be filled, hands it back to the replacement policy
+	 * and unlatches it.
+	 *
+	 * @param frame   	Frame to release
+	 */
+  void releaseFrame(const FrameId frame);
+
+	/**
+	 * Moves the page in frame from to the empty frame to, along with its pins, dirty page table entry, hash table
+	 * entry, place in its file's frame list and swizzled references, and clears frame from. Both frames are
+	 * latched, or the pool is being resized.
+	 *
+	 * @param from   	Frame holding the page
+	 * @param to    	Empty frame the page moves to
+	 */
+  void moveFrame(const FrameId from, const FrameId to);
+
+	/**
+	 * Called with the latch held when the last pin on a page above the cut of a shrink goes. Moves the page to a
+	 * frame below the cut, or if every frame there is pinned, writes it back if dirty and drops it.
+	 *
+	 * @param frame   	Frame past numBufs holding the page
+	 */
+  void retireFrame(const FrameId frame);
 
 	/**
 	 * Allocate a free frame.  
+	 * The frame is returned cleared and with its latch held; the caller must unlock it once the frame is set up.
+	 * Frames latched by other threads are skipped.
 	 *
 	 * @param frame   	Frame reference, frame ID of allocated frame returned via this variable
-	 * @throws BufferExceededException If no such buffer is found which can be allocated
+	 * @return  False if no such buffer is found which can be allocated
+	 */
+  bool allocBuf(FrameId & frame);
+
+	/**
+	 * Maximum number of consecutive pages warmFrom() reads with a single read
+	 */
+  static const std::uint32_t WARM_READ_RUN = 64;
+
+	/**
+	 * Loads consecutive pages of a file, unpinned, with a single read. Pages that are already resident, free or
+	 * past the end of the file are skipped.
+	 *
+	 * @param file   	File object
+	 * @param run			Page numbers to load, consecutive and in ascending order
+	 * @param loaded	Incremented for every page loaded
+	 * @return  False if the run was cut short because every frame is pinned or was just loaded
 	 */
-  void allocBuf(FrameId & frame);
+  bool warmRun(File* file, const std::vector<PageId>& run, std::uint32_t& loaded);
 
  public:
 	/**
-   * Actual buffer pool from which frames are allocated
+   * Marks a page reference that readChild() has swizzled: the other bits hold the frame of the referenced page
+   * instead of its page number
 	 */
-  Page* bufPool;
+  static const PageId SWIZZLED_BIT = 0x80000000;
 
 	/**
    * Constructor of BufMgr class
+	 *
+	 * @param bufs    	Number of frames in the buffer pool
+	 * @param policyType	Replacement policy used to choose victim frames
+	 * @param allocation	How the memory of the pool is allocated; HUGE_PAGE_POOL starts in constant time and
+	 * 										aligns every frame to 4 KB
 	 */
-  BufMgr(std::uint32_t bufs);
+  BufMgr(std::uint32_t bufs, const ReplacementPolicyType policyType = CLOCK,
+         const PoolAllocation allocation = HEAP_POOL);
 	
 	/**
    * Destructor of BufMgr class
@@ -229,15 +762,155 @@ class BufMgr
 	 */
   void readPage(File* file, const PageId PageNo, Page*& page);
 
+	/**
+	 * Reads the given page from the file into a frame, like the other readPage(), and returns a handle holding
+	 * the pin. Unpinning through the handle needs no hash table lookup.
+	 *
+	 * @param file   	File object
+	 * @param PageNo  Page number in the file to be read
+	 * @return  Handle holding the pinned page
+	 */
+  PageHandle readPage(File* file, const PageId PageNo);
+
+	/**
+	 * Reads the page a reference stored in another resident page points to, such as a child link in a B+ tree
+	 * node, and swizzles the reference: while the child stays in the pool the slot holds its frame number tagged
+	 * with SWIZZLED_BIT, so following it again pins the frame directly, without a hash table lookup.
+	 *
+	 * Swizzled references never reach the disk. They are restored to page numbers when the child leaves the pool
+	 * and before the parent is written, and a parent with swizzled references is not evicted. Code that reads the
+	 * slots other than through readChild(), or moves or changes them, must call unswizzle() on the parent first.
+	 *
+	 * @param file   	File both pages belong to
+	 * @param parent	Handle pinning the page the slot is in
+	 * @param slot		The reference, inside the parent page
+	 * @param pageNo	Receives the page number of the child
+	 * @return  Handle holding the pinned child page
+	 * @throws  BufferExceededException If the child is not resident and every frame is pinned
+	 */
+  PageHandle readChild(File* file, const PageHandle& parent, PageId* slot, PageId& pageNo);
+
+	/**
+	 * Restores every swizzled reference in a pinned page to the page number it stands for.
+	 *
+	 * @param parent	Handle pinning the page
+	 */
+  void unswizzle(const PageHandle& parent);
+
+	/**
+	 * Reads the given page like readPage(), but reports a pool full of pinned pages through the return value
+	 * instead of BufferExceededException. Meant for callers that can back off and retry, so that running out of
+	 * frames does not cost an exception per miss.
+	 *
+	 * @param file   	File object
+	 * @param PageNo  Page number in the file to be read
+	 * @param page  	Reference to page pointer, set only if the page was pinned
+	 * @return  False if the page is not resident and every frame is pinned
+	 */
+  bool tryReadPage(File* file, const PageId PageNo, Page*& page);
+
+	/**
+	 * Reads the given page like tryReadPage(), returning the pin in a handle.
+	 *
+	 * @param file   	File object
+	 * @param PageNo  Page number in the file to be read
+	 * @param handle 	Handle the pin is moved into, left untouched if the page could not be pinned
+	 * @return  False if the page is not resident and every frame is pinned
+	 */
+  bool tryReadPage(File* file, const PageId PageNo, PageHandle& handle);
+
+	/**
+	 * Changes the number of frames in the buffer pool while it is in use. Calls on other threads wait while
+	 * the pool is resized; resize() itself waits for calls in progress to finish first.
+	 *
+	 * Growing adds frames and leaves resident pages where they are. Shrinking removes the frames with the highest
+	 * numbers. Their pages move to empty frames below the cut; those there is no room for are written if dirty
+	 * and dropped. Pointers to pages stay valid, since a pinned page never moves while it is pinned: a pinned page
+	 * above the cut stays in its frame until its last pin goes, and then moves below the cut. The memory of the
+	 * removed frames is freed by the first resize() after their pages have gone. The pool is left unchanged if
+	 * more pages are pinned than the new number of frames.
+	 *
+	 * @param newFrames	New number of frames
+	 * @throws  PagePinnedException If more pages are pinned than newFrames
+	 * @throws  InvalidPoolSizeException If newFrames is 0
+	 */
+  void resize(const std::uint32_t newFrames);
+
+	/**
+	 * Returns the number of frames in the buffer pool.
+	 */
+  std::uint32_t numFrames()
+  {
+    SharedGate::Guard gate(resizeGate);
+    return numBufs;
+  }
+
+	/**
+	 * Starts reading count consecutive pages of the file, beginning with firstPageNo, into the buffer pool in the
+	 * background. Returns immediately. The pages are not pinned; a later readPage() of one of them is a buffer hit
+	 * if it has arrived by then, or waits for the read in progress. Pages that are already resident or that can
+	 * not be read (past the end of the file, free pages) are skipped.
+	 *
+	 * @param file   				File object
+	 * @param firstPageNo		First page number to read
+	 * @param count					Number of pages to read
+	 */
+  void prefetch(File* file, const PageId firstPageNo, const std::uint32_t count);
+
+	/**
+	 * Starts reading the given pages of the file into the buffer pool in the background.
+	 *
+	 * @param file   	File object
+	 * @param pageNos	Page numbers to read, in the order they should be read
+	 */
+  void prefetch(File* file, const std::vector<PageId>& pageNos);
+
+	/**
+	 * Writes the file name and page number of every page in the pool to a file, so that warmFrom() can load the
+	 * same pages after a restart. Pages are listed hottest first, as far as the replacement policy can tell.
+	 *
+	 * @param path		File to write; replaced only once the new list is complete
+	 * @return  False if the file could not be written
+	 */
+  bool saveResidentSet(const std::string& path);
+
+	/**
+	 * Loads the pages listed by saveResidentSet() back into the pool, unpinned, as if they had been prefetched.
+	 * At most as many pages as the pool has frames are loaded, hottest first. The pages of each file are read in
+	 * page number order, with a single read for every run of consecutive pages.
+	 *
+	 * Since the pool tells files apart by File object, only pages of the given files are loaded: pass the objects
+	 * the workload is going to use. Meant for startup; loading may evict pages that are already in the pool.
+	 *
+	 * @param path		File written by saveResidentSet()
+	 * @param files		Files whose pages should be loaded
+	 * @return  Number of pages loaded, 0 if there is no list at path
+	 */
+  std::uint32_t warmFrom(const std::string& path, const std::vector<File*>& files);
+
 	/**
 	 * Unpin a page from memory since it is no longer required for it to remain in memory.
 	 *
 	 * @param file   	File object
 	 * @param PageNo  Page number
 	 * @param dirty		True if the page to be unpinned needs to be marked dirty	
+	 * @param lsn			LSN returned by LogManager::update() for the change to the page, 0 if it was not logged.
+	 * 							The page is not written back before the log is on disk up to the largest LSN given.
    * @throws  PageNotPinnedException If the page is not already pinned
 	 */
-  void unPinPage(File* file, const PageId PageNo, const bool dirty);
+  void unPinPage(File* file, const PageId PageNo, const bool dirty, const Lsn lsn = 0);
+
+	/**
+	 * Unpins a page like unPinPage(), but reports a page that is not resident or not pinned through the return
+	 * value instead of an exception.
+	 *
+	 * @param file   	File object
+	 * @param PageNo  Page number
+	 * @param dirty		True if the page to be unpinned needs to be marked dirty
+	 * @param lsn			LSN of the logged change to the page, 0 if it was not logged
+	 * @return  False if the page is not in the buffer pool or not pinned
+	 */
+  bool tryUnPinPage(File* file, const PageId PageNo, const bool dirty, const Lsn lsn = 0);
 
 	/**
 	 * Allocates a new, empty page in the file and returns the Page object.
@@ -246,13 +919,27 @@ class BufMgr
 	 * @param file   	File object
 	 * @param PageNo  Page number. The number assigned to the page in the file is returned via this reference.
 	 * @param page  	Reference to page pointer. The newly allocated in-memory Page object is returned via this reference.
+	 * @param near		Page the new one will be read together with, such as its neighbour in a leaf chain. The file
+	 *							places the new page in the same extent if it can.
+	 */
+  void allocPage(File* file, PageId &PageNo, Page*& page, const PageId near = Page::INVALID_NUMBER); 
+
+	/**
+	 * Allocates a new, empty page in the file, like the other allocPage(), and returns a handle holding the pin.
+	 *
+	 * @param file   	File object
+	 * @param PageNo  Page number. The number assigned to the page in the file is returned via this reference.
+	 * @param near		Page to place the new one next to in the file, if possible
+	 * @return  Handle holding the pinned page
 	 */
-  void allocPage(File* file, PageId &PageNo, Page*& page); 
+  PageHandle allocPage(File* file, PageId &PageNo, const PageId near = Page::INVALID_NUMBER);
 
 	/**
 	 * Writes out all dirty pages of the file to disk.
 	 * All the frames assigned to the file need to be unpinned from buffer pool before this function can be successfully called.
-	 * Otherwise Error returned.
+	 * Otherwise Error returned, before anything is written.
+	 * The dirty pages are written in page number order, adjacent pages in a single write, followed by one sync of the file.
+	 * Only the frames holding pages of the file are visited, not the whole pool.
 	 *
 	 * @param file   	File object
    * @throws  PagePinnedException If any page of the file is pinned in the buffer pool 
@@ -260,6 +947,15 @@ class BufMgr
 	 */
   void flushFile(const File* file);
 
+	/**
+	 * Drops all pages of the file from the buffer pool without writing them. Changes to dirty pages are lost; use it
+	 * for files that are about to be removed, or call flushFile() instead.
+	 *
+	 * @param file   	File object
+   * @throws  PagePinnedException If any page of the file is pinned in the buffer pool
+	 */
+  void evictFile(const File* file);
+
 	/**
 	 * Delete page from file and also from buffer pool if present.
 	 * Since the page is entirely deleted from file, its unnecessary to see if the page is dirty.
@@ -270,10 +966,116 @@ class BufMgr
   void disposePage(File* file, const PageId PageNo);
 
 	/**
+	 * Starts a background thread that keeps the frames about to be chosen as victims clean, so that misses find
+	 * a clean frame and do not have to write one out first. Every intervalMs milliseconds the writer looks at the
+	 * next 2*pagesPerRound victim candidates and writes out up to pagesPerRound of them that are dirty and unpinned.
+	 * Does nothing if the writer is already running.
+	 *
+	 * @param pagesPerRound	Maximum number of pages written per round
+	 * @param intervalMs		Pause between rounds, in milliseconds
+	 */
+  void startBgWriter(const std::uint32_t pagesPerRound, const std::uint32_t intervalMs);
+
+	/**
+	 * Changes the rate of a running background writer.
+	 *
+	 * @param pagesPerRound	Maximum number of pages written per round
+	 * @param intervalMs		Pause between rounds, in milliseconds
+	 */
+  void setBgWriterRate(const std::uint32_t pagesPerRound, const std::uint32_t intervalMs);
+
+	/**
+	 * Stops the background writer and waits for its current round to finish.
+	 */
+  void stopBgWriter();
+
+	/**
+	 * Writes out the pages that have been dirty the longest and syncs their files. Only pages nobody has pinned
+	 * are written, since a pinned page may be half way through a change; they are left dirty for a later
+	 * checkpoint. Frames stay latched while their pages are written, so new pins of those pages wait for the
+	 * write. Frames latched by other threads are skipped.
+	 *
+	 * With a log attached, the log is then cut off up to the oldest change still only in memory, once that frees
+	 * at least half of it. A page that stays pinned holds the cut back to the point it was pinned at.
+	 *
+	 * @param maxPages	Maximum number of pages to write
+	 * @return  Number of pages written
+	 */
+  std::uint32_t checkpoint(const std::uint32_t maxPages);
+
+	/**
+	 * Starts a background thread that runs checkpoint(pagesPerRound) every intervalMs milliseconds, which bounds
+	 * both the I/O spent on checkpointing and, for a steady rate of new dirty pages, how long a page stays dirty.
+	 * Does nothing if the checkpointer is already running.
+	 *
+	 * @param pagesPerRound	Maximum number of pages written per round
+	 * @param intervalMs		Pause between rounds, in milliseconds
+	 */
+  void startCheckpointer(const std::uint32_t pagesPerRound, const std::uint32_t intervalMs);
+
+	/**
+	 * Changes the I/O budget of a running checkpointer.
+	 *
+	 * @param pagesPerRound	Maximum number of pages written per round
+	 * @param intervalMs		Pause between rounds, in milliseconds
+	 */
+  void setCheckpointRate(const std::uint32_t pagesPerRound, const std::uint32_t intervalMs);
+
+	/**
+	 * Stops the checkpointer and waits for its current round to finish.
+	 */
+  void stopCheckpointer();
+
+	/**
+	 * Returns the dirty page table, the pages that have been dirty the longest first.
+	 */
+  std::vector<DirtyPageEntry> dirtyPageTable();
+
+	/**
+	 * Attaches a write-ahead log. From then on every page write, whether on eviction, by the background writer,
+	 * by a checkpoint or by flushFile(), first flushes the log up to the page's LSN, so pages unpinned with an LSN
+	 * never reach the disk ahead of their log records. Attach the log before any page is dirtied with an LSN.
+	 * checkpoint() truncates the log, so a log must serve no more than one buffer manager.
+	 *
+	 * @param log		The log, which must outlive its use by the buffer manager; NULL detaches it
+	 */
+  void setLog(LogManager* log);
+
+	/**
+	 * Returns the attached write-ahead log, NULL if none.
+	 */
+  LogManager* getLog() const { return log; }
+
+	/**
+	 * Sets the memory budget of the compressed victim cache, a second tier behind the pool. Once enabled, pages
+	 * evicted from the pool are kept there compressed, after being written back if they were dirty, and a miss
+	 * looks for the page there before reading it from disk. 0, the default, disables the cache and frees it.
+	 *
+	 * @param bytes		Memory the victim cache may use, in bytes
+	 */
+  void setVictimCacheSize(const std::size_t bytes);
+
+	/**
+	 * Returns the number of pages in the victim cache
+	 */
+  std::size_t victimCachePages()
+  {
+		return victimCache.size();
+  }
+
+	/**
    * Print member variable values. 
 	 */
   void  printSelf();
 
+	/**
+   * Name of the replacement policy in use
+	 */
+  const char* policyName() const
+  {
+		return policy->name();
+  }
+
 	/**
    * Get buffer pool usage statistics
 	 */
@@ -289,6 +1091,12 @@ class BufMgr
   {
 		bufStats.clear();
   }
+
+	/**
+   * Writes the size and replacement policy of the pool and a snapshot of its statistics to os, as a single JSON
+   * object.
+	 */
+  void dumpStats(std::ostream& os);
 };
 
 }
@@ -0,0 +1,241 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include "buffer_stats.h"
+
+namespace badgerdb {
+
+BufCounterValues BufCounterValues::operator-(const BufCounterValues& earlier) const
+{
+  BufCounterValues diff;
+  diff.hits = hits - earlier.hits;
+  diff.misses = misses - earlier.misses;
+  diff.evictions = evictions - earlier.evictions;
+  diff.dirtyEvictions = dirtyEvictions - earlier.dirtyEvictions;
+  return diff;
+}
+
+BufCounterValues BufCounters::values() const
+{
+  BufCounterValues v;
+  v.hits = hits;
+  v.misses = misses;
+  v.evictions = evictions;
+  v.dirtyEvictions = dirtyEvictions;
+  return v;
+}
+
+//----------------------------------------
+// BufStatsSnapshot
+//----------------------------------------
+
+BufStatsSnapshot::BufStatsSnapshot()
+	: accesses(0), hits(0), misses(0), diskreads(0), diskwrites(0), evictions(0), dirtyEvictions(0), pinWaits(0),
+	  sweepSteps(0), bgwrites(0), checkpointWrites(0), prefetches(0),
+	  victimStores(0), victimHits(0), swizzledHits(0)
+{
+}
+
+BufStatsSnapshot BufStatsSnapshot::operator-(const BufStatsSnapshot& earlier) const
+{
+  BufStatsSnapshot diff;
+  diff.accesses = accesses - earlier.accesses;
+  diff.hits = hits - earlier.hits;
+  diff.misses = misses - earlier.misses;
+  diff.diskreads = diskreads - earlier.diskreads;
+  diff.diskwrites = diskwrites - earlier.diskwrites;
+  diff.evictions = evictions - earlier.evictions;
+  diff.dirtyEvictions = dirtyEvictions - earlier.dirtyEvictions;
+  diff.pinWaits = pinWaits - earlier.pinWaits;
+  diff.sweepSteps = sweepSteps - earlier.sweepSteps;
+  diff.bgwrites = bgwrites - earlier.bgwrites;
+  diff.checkpointWrites = checkpointWrites - earlier.checkpointWrites;
+  diff.prefetches = prefetches - earlier.prefetches;
+  diff.victimStores = victimStores - earlier.victimStores;
+  diff.victimHits = victimHits - earlier.victimHits;
+  diff.swizzledHits = swizzledHits - earlier.swizzledHits;
+
+  for (int r = 0; r < 2; r++)
+    diff.roles[r] = roles[r] - earlier.roles[r];
+
+  for (std::map<std::string, BufCounterValues>::const_iterator it = files.begin(); it != files.end(); ++it)
+  {
+    std::map<std::string, BufCounterValues>::const_iterator old = earlier.files.find(it->first);
+    diff.files[it->first] = (old == earlier.files.end()) ? it->second : it->second - old->second;
+  }
+
+  diff.missLatency = missLatency;
+  for (std::size_t i = 0; i < diff.missLatency.size() && i < earlier.missLatency.size(); i++)
+    diff.missLatency[i] -= earlier.missLatency[i];
+  return diff;
+}
+
+double BufStatsSnapshot::hitRate() const
+{
+  return accesses == 0 ? 0.0 : (double) hits / accesses;
+}
+
+std::uint64_t BufStatsSnapshot::missLatencyPercentile(const double fraction) const
+{
+  std::uint64_t total = 0;
+  for (std::size_t i = 0; i < missLatency.size(); i++)
+    total += missLatency[i];
+  if (total == 0)
+    return 0;
+
+  // the bucket holding the requested rank, reported by its upper bound
+  const std::uint64_t rank = (std::uint64_t) (fraction * total + 0.5);
+  std::uint64_t seen = 0;
+  for (std::size_t i = 0; i < missLatency.size(); i++)
+  {
+    seen += missLatency[i];
+    if (seen >= rank && seen > 0)
+      return std::uint64_t(1) << i;
+  }
+  return std::uint64_t(1) << (missLatency.size() - 1);
+}
+
+namespace {
+
+void dumpCounters(std::ostream& os, const BufCounterValues& v)
+{
+  os << "{\"hits\":" << v.hits << ",\"misses\":" << v.misses << ",\"evictions\":" << v.evictions
+     << ",\"dirty_evictions\":" << v.dirtyEvictions << "}";
+}
+
+void dumpString(std::ostream& os, const std::string& s)
+{
+  os << '"';
+  for (std::size_t i = 0; i < s.size(); i++)
+  {
+    if (s[i] == '"' || s[i] == '\\')
+      os << '\\';
+    os << s[i];
+  }
+  os << '"';
+}
+
+}
+
+void BufStatsSnapshot::dump(std::ostream& os) const
+{
+  os << "{\"accesses\":" << accesses << ",\"hits\":" << hits << ",\"misses\":" << misses
+     << ",\"disk_reads\":" << diskreads << ",\"disk_writes\":" << diskwrites << ",\"evictions\":" << evictions
+     << ",\"dirty_evictions\":" << dirtyEvictions << ",\"pin_waits\":" << pinWaits
+     << ",\"sweep_steps\":" << sweepSteps << ",\"bg_writes\":" << bgwrites
+     << ",\"checkpoint_writes\":" << checkpointWrites << ",\"prefetches\":" << prefetches
+     << ",\"victim_stores\":" << victimStores << ",\"victim_hits\":" << victimHits
+     << ",\"swizzled_hits\":" << swizzledHits;
+
+  os << ",\"heap\":";
+  dumpCounters(os, roles[HEAP_FILE]);
+  os << ",\"index\":";
+  dumpCounters(os, roles[INDEX_FILE]);
+
+  os << ",\"files\":{";
+  for (std::map<std::string, BufCounterValues>::const_iterator it = files.begin(); it != files.end(); ++it)
+  {
+    if (it != files.begin())
+      os << ",";
+    dumpString(os, it->first);
+    os << ":";
+    dumpCounters(os, it->second);
+  }
+
+  // bucket upper bounds in microseconds
+  os << "},\"miss_latency_us\":{";
+  for (std::size_t i = 0; i < missLatency.size(); i++)
+  {
+    if (i > 0)
+      os << ",";
+    os << "\"" << (std::uint64_t(1) << i) << "\":" << missLatency[i];
+  }
+  os << "}}";
+}
+
+//----------------------------------------
+// BufStats
+//----------------------------------------
+
+BufStats::BufStats()
+	: roles{{HEAP_FILE}, {INDEX_FILE}}
+{
+  clear();
+}
+
+void BufStats::clear()
+{
+  accesses = hits = misses = diskreads = diskwrites = evictions = dirtyEvictions = 0;
+  pinWaits = sweepSteps = bgwrites = checkpointWrites = prefetches = victimStores = victimHits = swizzledHits = 0;
+  roles[HEAP_FILE].clear();
+  roles[INDEX_FILE].clear();
+  for (int i = 0; i < LATENCY_BUCKETS; i++)
+    missLatency[i] = 0;
+
+  // the counters themselves stay, resident pages point at them
+  std::lock_guard<std::mutex> guard(filesMutex);
+  for (std::map<std::string, std::unique_ptr<BufCounters> >::iterator it = files.begin(); it != files.end(); ++it)
+    it->second->clear();
+}
+
+BufCounters* BufStats::countersOf(const File* file)
+{
+  std::lock_guard<std::mutex> guard(filesMutex);
+  std::unique_ptr<BufCounters>& counters = files[file->filename()];
+  if (!counters)
+    counters.reset(new BufCounters(file->role()));
+  return counters.get();
+}
+
+void BufStats::countMiss(BufCounters& file, const std::chrono::steady_clock::duration serviceTime)
+{
+  misses++;
+  file.misses++;
+  roles[file.role].misses++;
+
+  std::uint64_t us = std::chrono::duration_cast<std::chrono::microseconds>(serviceTime).count();
+  int bucket = 0;
+  while (us > 0 && bucket < LATENCY_BUCKETS - 1)
+  {
+    us >>= 1;
+    bucket++;
+  }
+  missLatency[bucket]++;
+}
+
+BufStatsSnapshot BufStats::snapshot() const
+{
+  BufStatsSnapshot snap;
+  snap.accesses = accesses;
+  snap.hits = hits;
+  snap.misses = misses;
+  snap.diskreads = diskreads;
+  snap.diskwrites = diskwrites;
+  snap.evictions = evictions;
+  snap.dirtyEvictions = dirtyEvictions;
+  snap.pinWaits = pinWaits;
+  snap.sweepSteps = sweepSteps;
+  snap.bgwrites = bgwrites;
+  snap.checkpointWrites = checkpointWrites;
+  snap.prefetches = prefetches;
+  snap.victimStores = victimStores;
+  snap.victimHits = victimHits;
+  snap.swizzledHits = swizzledHits;
+  snap.roles[HEAP_FILE] = roles[HEAP_FILE].values();
+  snap.roles[INDEX_FILE] = roles[INDEX_FILE].values();
+
+  snap.missLatency.resize(LATENCY_BUCKETS);
+  for (int i = 0; i < LATENCY_BUCKETS; i++)
+    snap.missLatency[i] = missLatency[i];
+
+  std::lock_guard<std::mutex> guard(filesMutex);
+  for (std::map<std::string, std::unique_ptr<BufCounters> >::const_iterator it = files.begin(); it != files.end(); ++it)
+    snap.files[it->first] = it->second->values();
+  return snap;
+}
+
+}
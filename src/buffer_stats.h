@@ -0,0 +1,314 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "file.h"
+
+namespace badgerdb {
+
+/**
+ * @brief Values of the counters kept for one file or one file role, as read by BufStats::snapshot().
+ */
+struct BufCounterValues
+{
+	/**
+   * Number of readPage calls on the file's pages served without going to disk
+	 */
+  std::uint64_t hits;
+
+	/**
+   * Number of readPage calls on the file's pages that read the page from disk
+	 */
+  std::uint64_t misses;
+
+	/**
+   * Number of the file's pages evicted to make room for another page
+	 */
+  std::uint64_t evictions;
+
+	/**
+   * Number of the evictions that had to write the page back first
+	 */
+  std::uint64_t dirtyEvictions;
+
+  BufCounterValues()
+    : hits(0), misses(0), evictions(0), dirtyEvictions(0)
+  {
+  }
+
+  BufCounterValues operator-(const BufCounterValues& earlier) const;
+};
+
+/**
+ * @brief Hit, miss and eviction counters of one file or one file role.
+ */
+struct BufCounters
+{
+  std::atomic<std::uint64_t> hits;
+  std::atomic<std::uint64_t> misses;
+  std::atomic<std::uint64_t> evictions;
+  std::atomic<std::uint64_t> dirtyEvictions;
+
+	/**
+   * What the counted file holds
+	 */
+  const FileRole role;
+
+  BufCounters(const FileRole role)
+    : role(role)
+  {
+    clear();
+  }
+
+  void clear()
+  {
+    hits = misses = evictions = dirtyEvictions = 0;
+  }
+
+  BufCounterValues values() const;
+};
+
+/**
+ * @brief A copy of all buffer pool statistics taken at one moment.
+ *
+ * Snapshots are plain values: subtracting an earlier snapshot from a later one gives the activity in between,
+ * and dump() writes a snapshot out as JSON for tools to read.
+ */
+struct BufStatsSnapshot
+{
+  std::uint64_t accesses;
+  std::uint64_t hits;
+  std::uint64_t misses;
+  std::uint64_t diskreads;
+  std::uint64_t diskwrites;
+  std::uint64_t evictions;
+  std::uint64_t dirtyEvictions;
+  std::uint64_t pinWaits;
+  std::uint64_t sweepSteps;
+  std::uint64_t bgwrites;
+  std::uint64_t checkpointWrites;
+  std::uint64_t prefetches;
+  std::uint64_t victimStores;
+  std::uint64_t victimHits;
+  std::uint64_t swizzledHits;
+
+	/**
+   * Counters of heap and index files, indexed by FileRole
+	 */
+  BufCounterValues roles[2];
+
+	/**
+   * Counters of every file that has had a page in the pool, by file name
+	 */
+  std::map<std::string, BufCounterValues> files;
+
+	/**
+   * Miss service times. Bucket 0 counts misses served in less than 1 microsecond, bucket i > 0 those that took
+   * from 2^(i-1) up to 2^i microseconds; the last bucket also takes everything slower.
+	 */
+  std::vector<std::uint64_t> missLatency;
+
+  BufStatsSnapshot();
+
+	/**
+   * Returns the activity between an earlier snapshot and this one. Files that only appear in this snapshot are
+   * taken as they are.
+	 */
+  BufStatsSnapshot operator-(const BufStatsSnapshot& earlier) const;
+
+	/**
+   * Fraction of accesses that were buffer hits
+	 */
+  double hitRate() const;
+
+	/**
+   * Returns an upper bound, in microseconds, of the service time of the given fraction of misses.
+   *
+   * @param fraction  Fraction of misses, between 0 and 1; 0.99 gives the 99th percentile
+	 */
+  std::uint64_t missLatencyPercentile(const double fraction) const;
+
+	/**
+   * Writes the snapshot to os as a single JSON object.
+	 */
+  void dump(std::ostream& os) const;
+};
+
+/**
+ * @brief Statistics kept by the buffer manager.
+ *
+ * The pool-wide counters can be read directly. Per-file counters are created the first time a file gets a page
+ * into the pool and kept until the BufStats goes away, so the descriptors of resident pages can point at them
+ * and count hits without a lookup. All counters are 64 bits and updated atomically, without locks.
+ */
+class BufStats
+{
+ public:
+	/**
+   * Total number of accesses to buffer pool (readPage and allocPage calls)
+	 */
+  std::atomic<std::uint64_t> accesses;
+
+	/**
+   * Number of readPage calls served without going to disk
+	 */
+  std::atomic<std::uint64_t> hits;
+
+	/**
+   * Number of readPage calls that read the page from disk
+	 */
+  std::atomic<std::uint64_t> misses;
+
+	/**
+   * Number of pages read from disk, including the prefetches
+	 */
+  std::atomic<std::uint64_t> diskreads;
+
+	/**
+   * Number of pages written back to disk
+	 */
+  std::atomic<std::uint64_t> diskwrites;
+
+	/**
+   * Number of resident pages evicted to make room for another page
+	 */
+  std::atomic<std::uint64_t> evictions;
+
+	/**
+   * Number of the evictions that had to write the page back first
+	 */
+  std::atomic<std::uint64_t> dirtyEvictions;
+
+	/**
+   * Number of buffer hits that had to wait for the frame latch, mostly for a read of the page in progress
+	 */
+  std::atomic<std::uint64_t> pinWaits;
+
+	/**
+   * Number of candidate frames the replacement policy offered while looking for victims
+	 */
+  std::atomic<std::uint64_t> sweepSteps;
+
+	/**
+   * Number of the diskwrites done by the background writer rather than on the miss path
+	 */
+  std::atomic<std::uint64_t> bgwrites;
+
+	/**
+   * Number of the diskwrites done by checkpoints
+	 */
+  std::atomic<std::uint64_t> checkpointWrites;
+
+	/**
+   * Number of the diskreads done by the prefetcher rather than on the miss path
+	 */
+  std::atomic<std::uint64_t> prefetches;
+
+	/**
+   * Number of evicted pages kept in the compressed victim cache
+	 */
+  std::atomic<std::uint64_t> victimStores;
+
+	/**
+   * Number of misses served from the compressed victim cache instead of disk; these are not diskreads
+	 */
+  std::atomic<std::uint64_t> victimHits;
+
+	/**
+   * Number of buffer hits that followed a swizzled reference instead of looking the page up
+	 */
+  std::atomic<std::uint64_t> swizzledHits;
+
+	/**
+   * Constructor of BufStats class
+	 */
+  BufStats();
+
+	/**
+   * Clear all values
+	 */
+  void clear();
+
+	/**
+   * Fraction of accesses that were buffer hits
+	 */
+  double hitRate() const
+  {
+		return accesses == 0 ? 0.0 : (double) hits / accesses;
+  }
+
+	/**
+   * Returns the counters of the given file, creating them if the file has none yet. Files are told apart by name.
+	 */
+  BufCounters* countersOf(const File* file);
+
+	/**
+   * Counts a buffer hit on a page of the file the counters belong to.
+	 */
+  void countHit(BufCounters& file)
+  {
+    hits++;
+    file.hits++;
+    roles[file.role].hits++;
+  }
+
+	/**
+   * Counts a miss on a page of the file the counters belong to.
+   *
+   * @param file        Counters of the file
+   * @param serviceTime Time from the start of the miss until the page was in the pool
+	 */
+  void countMiss(BufCounters& file, const std::chrono::steady_clock::duration serviceTime);
+
+	/**
+   * Counts the eviction of a page of the file the counters belong to.
+	 */
+  void countEviction(BufCounters& file, const bool dirty)
+  {
+    evictions++;
+    file.evictions++;
+    roles[file.role].evictions++;
+    if (dirty)
+    {
+      dirtyEvictions++;
+      file.dirtyEvictions++;
+      roles[file.role].dirtyEvictions++;
+    }
+  }
+
+	/**
+   * Copies all statistics.
+	 */
+  BufStatsSnapshot snapshot() const;
+
+ private:
+  static const int LATENCY_BUCKETS = 32;
+
+  BufCounters roles[2];
+
+  std::atomic<std::uint64_t> missLatency[LATENCY_BUCKETS];
+
+  std::map<std::string, std::unique_ptr<BufCounters> > files;
+
+	/**
+   * Protects the files map; the counters in it are atomic
+	 */
+  mutable std::mutex filesMutex;
+};
+
+}
@@ -0,0 +1,40 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <string>
+
+#include "badgerdb_exception.h"
+
+namespace badgerdb {
+
+/**
+ * @brief An exception that is thrown when a data file can not be opened, read, written or synced.
+ */
+class FileIOException : public BadgerDbException {
+ public:
+  /**
+   * Constructs the exception for the given file.
+   *
+   * @param name  Name of the file.
+   */
+  explicit FileIOException(const std::string& name);
+
+  /**
+   * Returns the name of the file that caused this exception.
+   */
+  virtual const std::string& filename() const { return filename_; }
+
+ protected:
+  /**
+   * Name of the file that caused this exception.
+   */
+  const std::string filename_;
+};
+
+}
@@ -0,0 +1,22 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include "invalid_pool_size_exception.h"
+
+#include <sstream>
+#include <string>
+
+namespace badgerdb {
+
+InvalidPoolSizeException::InvalidPoolSizeException(const std::uint32_t numFramesIn)
+    : BadgerDbException(""), numFrames_(numFramesIn) {
+  std::stringstream ss;
+  ss << "Invalid buffer pool size: " << numFrames_ << " frames";
+  message_.assign(ss.str());
+}
+
+}
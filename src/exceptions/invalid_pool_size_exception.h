@@ -0,0 +1,41 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include "badgerdb_exception.h"
+
+namespace badgerdb {
+
+/**
+ * @brief An exception that is thrown when a buffer pool is given a size it can not have.
+ */
+class InvalidPoolSizeException : public BadgerDbException {
+ public:
+  /**
+   * Constructs an invalid pool size exception for the given number of frames.
+   */
+  explicit InvalidPoolSizeException(const std::uint32_t numFramesIn);
+
+  /**
+   * Returns the number of frames requested.
+   *
+   * @return  Number of frames.
+   */
+  virtual std::uint32_t numFrames() const { return numFrames_; }
+
+ protected:
+  /**
+   * Number of frames requested.
+   */
+  const std::uint32_t numFrames_;
+};
+
+}
@@ -0,0 +1,40 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <string>
+
+#include "badgerdb_exception.h"
+
+namespace badgerdb {
+
+/**
+ * @brief An exception that is thrown when a buffer pool is created under a name that is already in use.
+ */
+class PoolExistsException : public BadgerDbException {
+ public:
+  /**
+   * Constructs the exception for the given pool name.
+   *
+   * @param name  Name of the buffer pool.
+   */
+  explicit PoolExistsException(const std::string& name);
+
+  /**
+   * Returns the name of the pool that caused this exception.
+   */
+  virtual const std::string& poolName() const { return poolName_; }
+
+ protected:
+  /**
+   * Name of the pool that caused this exception.
+   */
+  const std::string poolName_;
+};
+
+}
@@ -12,9 +12,19 @@
 #include <memory>
 #include <string>
 #include <cstdio>
+#include <cstring>
 #include <cassert>
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 #include "exceptions/file_exists_exception.h"
+#include "exceptions/file_io_exception.h"
 #include "exceptions/file_not_found_exception.h"
 #include "exceptions/file_open_exception.h"
 #include "exceptions/invalid_page_exception.h"
@@ -23,10 +33,83 @@
 
 namespace badgerdb {
 
-File::StreamMap File::open_streams_;
+File::FileMap File::open_files_;
 File::CountMap File::open_counts_;
+std::recursive_mutex File::registry_mutex_;
+
+static_assert(Page::SIZE % File::DIRECT_IO_ALIGNMENT == 0,
+              "pages must stay aligned for direct I/O");
+
+namespace {
+
+/**
+ * Memory aligned for direct I/O, freed when the object goes out of scope.
+ */
+class AlignedBuffer {
+ public:
+  explicit AlignedBuffer(const std::size_t size) : data_(NULL) {
+    void* mem;
+    if (posix_memalign(&mem, File::DIRECT_IO_ALIGNMENT, size > 0 ? size : 1) != 0) {
+      throw std::bad_alloc();
+    }
+    data_ = static_cast<char*>(mem);
+  }
+
+  ~AlignedBuffer() { std::free(data_); }
+
+  char* data() const { return data_; }
+
+ private:
+  AlignedBuffer(const AlignedBuffer&);
+  AlignedBuffer& operator=(const AlignedBuffer&);
+
+  char* data_;
+};
+
+void preadFully(const int fd, char* bytes, const std::size_t size, const std::streamoff position,
+                const std::string& filename) {
+  std::size_t done = 0;
+  while (done < size) {
+    const ssize_t n = ::pread(fd, bytes + done, size - done, static_cast<off_t>(position + done));
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      throw FileIOException(filename);
+    }
+    if (n == 0) {
+      // past the end of the file
+      std::memset(bytes + done, 0, size - done);
+      return;
+    }
+    done += n;
+  }
+}
+
+void pwriteFully(const int fd, const char* bytes, const std::size_t size, const std::streamoff position,
+                 const std::string& filename) {
+  std::size_t done = 0;
+  while (done < size) {
+    const ssize_t n = ::pwrite(fd, bytes + done, size - done, static_cast<off_t>(position + done));
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      throw FileIOException(filename);
+    }
+    done += n;
+  }
+}
+
+bool isAligned(const void* buffer, const std::size_t size, const std::streamoff position) {
+  return reinterpret_cast<std::uintptr_t>(buffer) % File::DIRECT_IO_ALIGNMENT == 0 &&
+      size % File::DIRECT_IO_ALIGNMENT == 0 && position % File::DIRECT_IO_ALIGNMENT == 0;
+}
+
+}
 
 void File::remove(const std::string& filename) {
+  std::lock_guard<std::recursive_mutex> guard(registry_mutex_);
   if (!exists(filename)) {
     throw FileNotFoundException(filename);
   }
@@ -37,6 +120,7 @@ void File::remove(const std::string& filename) {
 }
 
 bool File::isOpen(const std::string& filename) {
+  std::lock_guard<std::recursive_mutex> guard(registry_mutex_);
   if (!exists(filename)) {
     return false;
   }
@@ -54,6 +138,17 @@ bool File::exists(const std::string& filename) {
 	return false;
 }
 
+void File::syncAll() {
+  std::lock_guard<std::recursive_mutex> guard(registry_mutex_);
+  for (FileMap::iterator it = open_files_.begin(); it != open_files_.end(); ++it) {
+    OpenFile& file = *it->second;
+    if (file.unsynced.exchange(false) && ::fsync(file.fd) != 0) {
+      file.unsynced = true;
+      throw FileIOException(it->first);
+    }
+  }
+}
+
 File::~File() {
   close();
 }
@@ -64,84 +159,436 @@ PageId File::getFirstPageNo() {
   return header.first_used_page;
 }
 
-File::File(const std::string& name, const bool create_new) : filename_(name) {
-  openIfNeeded(create_new);
+PageId File::getNumPages() {
+  const FileHeader& header = readHeader();
+  return header.num_pages - 1;
+}
+
+PageId File::getNumUsedPages() {
+  const FileHeader& header = readHeader();
+  return header.num_pages - 1 - header.num_free_pages;
+}
+
+File::File(const std::string& name, const bool create_new, const bool direct_io) : filename_(name) {
+  openIfNeeded(create_new, direct_io);
 
   if (create_new) {
     // File starts with 1 page (the header).
     FileHeader header = {1 /* num_pages */, 0 /* first_used_page */,
-                         0 /* num_free_pages */, 0 /* first_free_page */};
+                         0 /* num_free_pages */, 0 /* first_free_page */,
+                         0 /* last_used_page */};
     writeHeader(header);
+    flushHeader();
   }
 }
 
-void File::openIfNeeded(const bool create_new) {
+void File::openIfNeeded(const bool create_new, const bool direct_io) {
+  std::lock_guard<std::recursive_mutex> guard(registry_mutex_);
   if (open_counts_.find(filename_) != open_counts_.end()) {	//exists an entry already
     ++open_counts_[filename_];
-    stream_ = open_streams_[filename_];
+    open_file_ = open_files_[filename_];
   } else {
-    std::ios_base::openmode mode =
-        std::fstream::in | std::fstream::out | std::fstream::binary;
+    int flags = O_RDWR;
     const bool already_exists = exists(filename_);
     if (create_new) {
       // Error if we try to overwrite an existing file.
       if (already_exists) {
         throw FileExistsException(filename_);
       }
-      // New files have to be truncated on open.
-      mode = mode | std::fstream::trunc;
+      // New files have to be created on open.
+      flags |= O_CREAT | O_TRUNC;
     } else {
       // Error if we try to open a file that doesn't exist.
       if (!already_exists) {
         throw FileNotFoundException(filename_);
       }
     }
-    stream_.reset(new std::fstream(filename_, mode));
-    open_streams_[filename_] = stream_;
+#ifdef O_DIRECT
+    if (direct_io) {
+      flags |= O_DIRECT;
+    }
+#endif
+    const int fd = ::open(filename_.c_str(), flags, 0666);
+    if (fd < 0) {
+      throw FileIOException(filename_);
+    }
+#if !defined(O_DIRECT) && defined(F_NOCACHE)
+    if (direct_io && ::fcntl(fd, F_NOCACHE, 1) != 0) {
+      ::close(fd);
+      throw FileIOException(filename_);
+    }
+#endif
+    open_file_.reset(new OpenFile());
+    open_file_->fd = fd;
+    open_file_->direct_io = direct_io;
+    open_file_->header_dirty = false;
+    open_file_->unsynced = false;
+    if (!create_new) {
+      try {
+        readAt(&open_file_->header, sizeof(FileHeader), 0 /* pos */);
+      } catch (const FileIOException&) {
+        ::close(fd);
+        open_file_.reset();
+        throw;
+      }
+    }
+    open_files_[filename_] = open_file_;
     open_counts_[filename_] = 1;
   }
 }
 
 void File::close() {
+  std::lock_guard<std::recursive_mutex> guard(registry_mutex_);
 	if(open_counts_[filename_] > 0)
   	--open_counts_[filename_];
 
-  stream_.reset();
+  if (open_counts_[filename_] == 0 && open_file_) {
+    // last handle on the file; close() runs from destructors, so a header
+    // that can not be written is given up rather than thrown. Its writes must
+    // not go unsynced once syncAll() can no longer see it.
+    try {
+      flushHeader();
+    } catch (const FileIOException&) {
+    }
+    if (open_file_->unsynced) {
+      ::fsync(open_file_->fd);
+    }
+    ::close(open_file_->fd);
+  }
+  open_file_.reset();
 	assert(open_counts_[filename_] >= 0);
 
   if (open_counts_[filename_] == 0) {
-    open_streams_.erase(filename_);
+    open_files_.erase(filename_);
     open_counts_.erase(filename_);
   }
 }
 
 FileHeader File::readHeader() const {
-  FileHeader header;
-  stream_->seekg(0 /* pos */, std::ios::beg);
-  stream_->read(reinterpret_cast<char*>(&header), sizeof(FileHeader));
-  return header;
+  std::lock_guard<std::recursive_mutex> guard(open_file_->mutex);
+  return open_file_->header;
 }
 
 void File::writeHeader(const FileHeader& header) {
-  stream_->seekp(0 /* pos */, std::ios::beg);
-  stream_->write(reinterpret_cast<const char*>(&header), sizeof(FileHeader));
-  stream_->flush();
+  std::lock_guard<std::recursive_mutex> guard(open_file_->mutex);
+  open_file_->header = header;
+  open_file_->header_dirty = true;
 }
 
+void File::flushHeader() {
+  std::lock_guard<std::recursive_mutex> guard(open_file_->mutex);
+  if (!open_file_->header_dirty) {
+    return;
+  }
+  writeAt(&open_file_->header, sizeof(FileHeader), 0 /* pos */);
+  open_file_->header_dirty = false;
+}
 
+void File::readAt(void* buffer, const std::size_t size, const std::streampos position) const {
+  const std::streamoff offset = position;
+  if (!open_file_->direct_io || isAligned(buffer, size, offset)) {
+    preadFully(open_file_->fd, static_cast<char*>(buffer), size, offset, filename_);
+    return;
+  }
+  // read the aligned blocks around the range and copy it out
+  const std::streamoff start = offset / DIRECT_IO_ALIGNMENT * DIRECT_IO_ALIGNMENT;
+  const std::streamoff end = (offset + size + DIRECT_IO_ALIGNMENT - 1) / DIRECT_IO_ALIGNMENT * DIRECT_IO_ALIGNMENT;
+  const AlignedBuffer block(end - start);
+  preadFully(open_file_->fd, block.data(), end - start, start, filename_);
+  std::memcpy(buffer, block.data() + (offset - start), size);
+}
+
+void File::writeAt(const void* buffer, const std::size_t size, const std::streampos position) const {
+  const std::streamoff offset = position;
+  if (!open_file_->direct_io || isAligned(buffer, size, offset)) {
+    pwriteFully(open_file_->fd, static_cast<const char*>(buffer), size, offset, filename_);
+    open_file_->unsynced = true;
+    return;
+  }
+  // patch the range into the aligned blocks around it; only blocks the range
+  // covers in part need to be read first
+  const std::streamoff start = offset / DIRECT_IO_ALIGNMENT * DIRECT_IO_ALIGNMENT;
+  const std::streamoff end = (offset + size + DIRECT_IO_ALIGNMENT - 1) / DIRECT_IO_ALIGNMENT * DIRECT_IO_ALIGNMENT;
+  const AlignedBuffer block(end - start);
+  if (start != offset || end != offset + std::streamoff(size)) {
+    preadFully(open_file_->fd, block.data(), end - start, start, filename_);
+  }
+  std::memcpy(block.data() + (offset - start), buffer, size);
+  pwriteFully(open_file_->fd, block.data(), end - start, start, filename_);
+  open_file_->unsynced = true;
+}
+
+bool File::directIO() const {
+  return open_file_->direct_io;
+}
+
+void File::writePages(const std::vector<std::pair<PageId, const Page*> >& pages) {
+  std::vector<std::pair<PageId, const Page*> > sorted(pages);
+  std::sort(sorted.begin(), sorted.end());
+
+  std::lock_guard<std::recursive_mutex> guard(open_file_->mutex);
+  // a copy, since std::min() takes its arguments by reference
+  const std::size_t max_run = MAX_WRITE_RUN;
+  const AlignedBuffer run(std::min(sorted.size(), max_run) * Page::SIZE);
+  std::size_t start = 0;
+  while (start < sorted.size()) {
+    // extend the run while the page numbers stay consecutive and the pages
+    // adjacent on disk
+    std::size_t end = start + 1;
+    while (end < sorted.size() && end - start < MAX_WRITE_RUN &&
+           sorted[end].first == sorted[end - 1].first + 1 &&
+           pagePosition(sorted[end].first) == pagePosition(sorted[end - 1].first) + std::streamoff(Page::SIZE)) {
+      ++end;
+    }
+
+    // build the whole run before writing, since pageImage() may read from the file
+    for (std::size_t i = start; i < end; ++i) {
+      pageImage(sorted[i].first, *sorted[i].second, run.data() + (i - start) * Page::SIZE);
+    }
+    writeAt(run.data(), (end - start) * Page::SIZE, pagePosition(sorted[start].first));
+    start = end;
+  }
+}
+
+void File::readPages(const PageId first, const std::uint32_t count,
+                     std::vector<std::pair<PageId, Page> >& pages) const {
+  const FileHeader header = readHeader();
+  if (first >= header.num_pages) {
+    return;
+  }
+  const std::uint32_t available = header.num_pages - first;
+  std::uint32_t n = count < available ? count : available;
+  // stop the run where the pages stop being adjacent on disk
+  for (std::uint32_t i = 1; i < n; ++i) {
+    if (pagePosition(first + i) != pagePosition(first) + std::streamoff(i * Page::SIZE)) {
+      n = i;
+      break;
+    }
+  }
+
+  const AlignedBuffer run(n * Page::SIZE);
+  readAt(run.data(), n * Page::SIZE, pagePosition(first));
+
+  // The bits of the run's pages, which all lie in one directory block.
+  const PageId first_bit = (first - 1) % DIRECTORY_SPAN;
+  std::vector<unsigned char> directory((first_bit + n - 1) / 8 - first_bit / 8 + 1);
+  readAt(&directory[0], directory.size(), directoryPosition(first) + std::streamoff(first_bit / 8));
+
+  Page page;
+  for (std::uint32_t i = 0; i < n; ++i) {
+    const PageId bit = first_bit + i;
+    if ((directory[bit / 8 - first_bit / 8] & (1 << (bit % 8))) &&
+        pageFromImage(first + i, run.data() + i * Page::SIZE, page)) {
+      pages.push_back(std::make_pair(first + i, page));
+    }
+  }
+}
 
+PageId File::claimPage(FileHeader& header, const PageId near) {
+  std::lock_guard<std::recursive_mutex> guard(open_file_->mutex);
+  if (header.num_free_pages == 0) {
+    // Grow by a whole extent, with one write, rather than a page at a time.
+    // Extents never straddle a directory block, since DIRECTORY_SPAN is a
+    // multiple of EXTENT_PAGES.
+    const PageId first = header.num_pages;
+    if ((first - 1) % DIRECTORY_SPAN == 0) {
+      const AlignedBuffer directory(Page::SIZE);
+      std::memset(directory.data(), 0, Page::SIZE);
+      writeAt(directory.data(), Page::SIZE, directoryPosition(first));
+    }
+    const AlignedBuffer extent(EXTENT_PAGES * Page::SIZE);
+    std::memset(extent.data(), 0, EXTENT_PAGES * Page::SIZE);
+    writeAt(extent.data(), EXTENT_PAGES * Page::SIZE, pagePosition(first));
+    header.num_pages += EXTENT_PAGES;
+    header.num_free_pages = EXTENT_PAGES;
+    header.first_free_page = first;
+  }
 
+  PageId page_number = Page::INVALID_NUMBER;
+  if (near != Page::INVALID_NUMBER && near < header.num_pages) {
+    // Prefer the free page closest after near in its extent, then any free
+    // page of the extent.
+    const PageId extent_start = near - (near - 1) % EXTENT_PAGES;
+    page_number = nextFreePage(near + 1, extent_start + EXTENT_PAGES);
+    if (page_number == Page::INVALID_NUMBER) {
+      page_number = nextFreePage(extent_start, near);
+    }
+  }
+  if (page_number == Page::INVALID_NUMBER) {
+    page_number = header.first_free_page;
+  }
 
-PageFile PageFile::create(const std::string& filename) {
-  return PageFile(filename, true /* create_new */);
+  setUsed(page_number, true);
+  --header.num_free_pages;
+  if (page_number == header.first_free_page) {
+    header.first_free_page = header.num_free_pages == 0 ? Page::INVALID_NUMBER
+        : nextFreePage(page_number + 1, header.num_pages);
+  }
+  assert((header.num_free_pages == 0) ==
+         (header.first_free_page == Page::INVALID_NUMBER));
+  return page_number;
+}
+
+PageId File::nextFreePage(const PageId first, const PageId limit) const {
+  std::lock_guard<std::recursive_mutex> guard(open_file_->mutex);
+  std::vector<unsigned char> directory;
+  PageId page_number = first;
+  while (page_number < limit) {
+    // Read the bits of the rest of the range in this directory block at once.
+    const PageId block_start = page_number - (page_number - 1) % DIRECTORY_SPAN;
+    const PageId block_limit = std::min(limit, block_start + DIRECTORY_SPAN);
+    const PageId first_bit = page_number - block_start;
+    const PageId last_bit = block_limit - block_start - 1;
+    directory.resize(last_bit / 8 - first_bit / 8 + 1);
+    readAt(&directory[0], directory.size(), directoryPosition(block_start) + std::streamoff(first_bit / 8));
+    for (PageId bit = first_bit; bit <= last_bit; ++bit) {
+      if (!(directory[bit / 8 - first_bit / 8] & (1 << (bit % 8)))) {
+        return block_start + bit;
+      }
+    }
+    page_number = block_limit;
+  }
+  return Page::INVALID_NUMBER;
 }
 
-PageFile PageFile::open(const std::string& filename) {
-  return PageFile(filename, false /* create_new */);
+void File::setUsed(const PageId page_number, const bool used) {
+  std::lock_guard<std::recursive_mutex> guard(open_file_->mutex);
+  const PageId bit = (page_number - 1) % DIRECTORY_SPAN;
+  const std::streampos position = directoryPosition(page_number) + std::streamoff(bit / 8);
+  char byte;
+  readAt(&byte, 1, position);
+  if (used) {
+    byte |= (char) (1 << (bit % 8));
+  } else {
+    byte &= (char) ~(1 << (bit % 8));
+  }
+  writeAt(&byte, 1, position);
+}
+
+PageId File::previousUsedPage(const PageId page_number) const {
+  std::lock_guard<std::recursive_mutex> guard(open_file_->mutex);
+  std::vector<unsigned char> directory(Page::SIZE);
+  // First page covered by the directory block being searched, and how many of
+  // its bits count: in the block of page_number only those of the pages below
+  // it, in the blocks before it all of them.
+  PageId block_start = page_number - (page_number - 1) % DIRECTORY_SPAN;
+  PageId limit = page_number - block_start;
+  while (true) {
+    const std::size_t bytes = (limit + 7) / 8;
+    if (bytes > 0) {
+      readAt(&directory[0], bytes, directoryPosition(block_start));
+      for (std::size_t i = bytes; i-- > 0; ) {
+        unsigned char byte = directory[i];
+        if (i == limit / 8) {
+          byte &= (unsigned char) ((1 << (limit % 8)) - 1);
+        }
+        for (int b = 7; byte != 0 && b >= 0; --b) {
+          if (byte & (1 << b)) {
+            return block_start + i * 8 + b;
+          }
+        }
+      }
+    }
+    if (block_start == 1) {
+      return Page::INVALID_NUMBER;
+    }
+    block_start -= DIRECTORY_SPAN;
+    limit = DIRECTORY_SPAN;
+  }
 }
 
-PageFile::PageFile(const std::string& name, const bool create_new)
-: File(name, create_new)
+PageId File::nextUsedPage(const PageId page_number, DirectoryBlock& block) const {
+  std::lock_guard<std::recursive_mutex> guard(open_file_->mutex);
+  const PageId limit = readHeader().num_pages;
+  PageId next = page_number + 1;
+  while (next < limit) {
+    const PageId block_start = next - (next - 1) % DIRECTORY_SPAN;
+    const PageId count = std::min<PageId>(limit - block_start, PageId(DIRECTORY_SPAN));
+    if (block.first_page != block_start || block.bits.size() * 8 < count) {
+      block.bits.resize((count + 7) / 8);
+      readAt(&block.bits[0], block.bits.size(), directoryPosition(block_start));
+      block.first_page = block_start;
+    }
+    for (PageId bit = next - block_start; bit < count; ++bit) {
+      if (block.bits[bit / 8] == 0) {
+        // nothing used up to the end of this byte
+        bit |= 7;
+      } else if (block.bits[bit / 8] & (1 << (bit % 8))) {
+        return block_start + bit;
+      }
+    }
+    next = block_start + count;
+  }
+  return Page::INVALID_NUMBER;
+}
+
+void File::recoverHeader() {
+  std::lock_guard<std::recursive_mutex> guard(open_file_->mutex);
+  FileHeader header = readHeader();
+
+  // Extents are written whole, so every extent that reached the disk lies
+  // within the file. Past the header page, each directory block is followed
+  // by the DIRECTORY_SPAN pages it covers.
+  struct stat status;
+  if (::fstat(open_file_->fd, &status) != 0) {
+    throw FileIOException(filename_);
+  }
+  const std::streamoff blocks = std::max<std::streamoff>(status.st_size / Page::SIZE - 1, 0);
+  const std::streamoff rest = blocks % (DIRECTORY_SPAN + 1);
+  PageId pages = blocks / (DIRECTORY_SPAN + 1) * DIRECTORY_SPAN + (rest > 0 ? rest - 1 : 0);
+  pages -= pages % EXTENT_PAGES;
+  pages = std::max(pages, header.num_pages - 1);
+
+  // the used list runs in page number order, so its ends are the lowest and
+  // the highest used pages
+  header.num_pages = pages + 1;
+  header.num_free_pages = 0;
+  header.first_free_page = Page::INVALID_NUMBER;
+  header.first_used_page = Page::INVALID_NUMBER;
+  header.last_used_page = Page::INVALID_NUMBER;
+  std::vector<unsigned char> directory(Page::SIZE);
+  for (PageId block_start = 1; block_start <= pages; block_start += DIRECTORY_SPAN) {
+    const PageId count = std::min<PageId>(pages - block_start + 1, PageId(DIRECTORY_SPAN));
+    readAt(&directory[0], (count + 7) / 8, directoryPosition(block_start));
+    for (PageId bit = 0; bit < count; ++bit) {
+      const PageId page_number = block_start + bit;
+      if (directory[bit / 8] & (1 << (bit % 8))) {
+        if (header.first_used_page == Page::INVALID_NUMBER) {
+          header.first_used_page = page_number;
+        }
+        header.last_used_page = page_number;
+      } else if (header.num_free_pages++ == 0) {
+        header.first_free_page = page_number;
+      }
+    }
+  }
+  writeHeader(header);
+  flushHeader();
+}
+
+void File::sync() {
+  flushHeader();
+  open_file_->unsynced = false;
+  if (::fsync(open_file_->fd) != 0) {
+    open_file_->unsynced = true;
+    throw FileIOException(filename_);
+  }
+}
+
+
+
+
+
+PageFile PageFile::create(const std::string& filename, const bool direct_io) {
+  return PageFile(filename, true /* create_new */, direct_io);
+}
+
+PageFile PageFile::open(const std::string& filename, const bool direct_io) {
+  return PageFile(filename, false /* create_new */, direct_io);
+}
+
+PageFile::PageFile(const std::string& name, const bool create_new, const bool direct_io)
+: File(name, create_new, direct_io)
 {
 }
 
@@ -162,145 +609,130 @@ PageFile& PageFile::operator=(const PageFile& rhs) {
   return *this;
 }
 
-Page PageFile::allocatePage(PageId &new_page_number) {
-  FileHeader header = readHeader();
+Page PageFile::allocatePage(PageId &new_page_number, const PageId near) {
   Page new_page;
-  Page existing_page;
-  if (header.num_free_pages > 0) {
-    new_page = readPage(header.first_free_page, true /* allow_free */);
-    new_page.set_page_number(header.first_free_page);
-		new_page_number = new_page.page_number();
-    header.first_free_page = new_page.next_page_number();
-    --header.num_free_pages;
-
-    if (header.first_used_page == Page::INVALID_NUMBER ||
-        header.first_used_page > new_page.page_number()) {
-      // Either have no pages used or the head of the used list is a page later
-      // than the one we just allocated, so add the new page to the head.
-      if (header.first_used_page > new_page.page_number()) {
-        new_page.set_next_page_number(header.first_used_page);
-      }
-      header.first_used_page = new_page.page_number();
-    } else {
-      // New page is reused from somewhere after the beginning, so we need to
-      // find where in the used list to insert it.
-      PageId next_page_number = Page::INVALID_NUMBER;
-      for (FileIterator iter = begin(); iter != end(); ++iter) {
-        next_page_number = (*iter).next_page_number();
-        if (next_page_number > new_page.page_number() ||
-            next_page_number == Page::INVALID_NUMBER) {
-          existing_page = *iter;
-          break;
-        }
-      }
-      existing_page.set_next_page_number(new_page.page_number());
-      new_page.set_next_page_number(next_page_number);
-    }
+  allocatePageInto(new_page_number, new_page, near);
+  return new_page;
+}
 
-    assert((header.num_free_pages == 0) ==
-           (header.first_free_page == Page::INVALID_NUMBER));
+void PageFile::allocatePageInto(PageId &new_page_number, Page& new_page, const PageId near) {
+  std::lock_guard<std::recursive_mutex> guard(open_file_->mutex);
+  FileHeader header = readHeader();
+  new_page_number = claimPage(header, near);
+  new_page.initialize();
+  new_page.set_page_number(new_page_number);
+
+  // Link the page in after the closest used page before it: the tail if the
+  // page is past it, which is the usual case, or else the one the directory
+  // gives us without walking the used list.
+  const PageId previous_page_number =
+      (header.last_used_page != Page::INVALID_NUMBER && new_page_number > header.last_used_page)
+      ? header.last_used_page : previousUsedPage(new_page_number);
+  if (previous_page_number == Page::INVALID_NUMBER) {
+    new_page.set_next_page_number(header.first_used_page);
+    header.first_used_page = new_page_number;
+  } else {
+    PageHeader previous_header = readPageHeader(previous_page_number);
+    new_page.set_next_page_number(previous_header.next_page_number);
+    previous_header.next_page_number = new_page_number;
+    writePageHeader(previous_page_number, previous_header);
   }
-	else
-	{
-    new_page.set_page_number(header.num_pages);
-		new_page_number = new_page.page_number();
-
-    if (header.first_used_page == Page::INVALID_NUMBER)
-		{
-      header.first_used_page = new_page.page_number();
-    }
-		else
-		{
-      // If we have pages allocated, we need to add the new page to the tail
-      // of the linked list.
-      for (FileIterator iter = begin(); iter != end(); ++iter) {
-        if ((*iter).next_page_number() == Page::INVALID_NUMBER) {
-          existing_page = *iter;
-          break;
-        }
-      }
-      assert(existing_page.isUsed());
-      existing_page.set_next_page_number(new_page.page_number());
-    }
-    ++header.num_pages;
+  if (new_page.next_page_number() == Page::INVALID_NUMBER) {
+    header.last_used_page = new_page_number;
   }
+
   writePage(new_page_number, new_page.header_, new_page);
-  if (existing_page.page_number() != Page::INVALID_NUMBER) {
-    // If we updated an existing page by inserting the new page into the
-    // used list, we need to write it out.
-    writePage(existing_page.page_number(), existing_page.header_, existing_page);
-  }
   writeHeader(header);
-
-  return new_page;
 }
 
 Page PageFile::readPage(const PageId page_number) const {
+  Page page;
+  readPageInto(page_number, page);
+  return page;
+}
+
+void PageFile::readPageInto(const PageId page_number, Page& page) const {
   FileHeader header = readHeader();
 
 	if (page_number >= header.num_pages)
 	{
 		throw InvalidPageException(page_number, filename_);
 	}
-	return readPage(page_number, false /* allow_free */);
+	readPageInto(page_number, false /* allow_free */, page);
 }
 
 Page PageFile::readPage(const PageId page_number, const bool allow_free) const {
   Page page;
-  stream_->seekg(pagePosition(page_number), std::ios::beg);
-  stream_->read(reinterpret_cast<char*>(&page.header_), sizeof(PageHeader));
-  stream_->read(&page.data_[0], Page::DATA_SIZE);
+  readPageInto(page_number, allow_free, page);
+  return page;
+}
+
+void PageFile::readPageInto(const PageId page_number, const bool allow_free, Page& page) const {
+  readAt(&page, Page::SIZE, pagePosition(page_number));
   if (!allow_free && !page.isUsed()) {
     throw InvalidPageException(page_number, filename_);
   }
-
-  return page;
 }
 
 void PageFile::writePage(const PageId new_page_number, const Page& new_page) {
-	PageHeader header = readPageHeader(new_page_number);
+  std::lock_guard<std::recursive_mutex> guard(open_file_->mutex);
+	writePage(new_page_number, headerForWrite(new_page_number, new_page), new_page);
+}
+
+PageHeader PageFile::headerForWrite(const PageId page_number, const Page& page) const {
+	PageHeader header = readPageHeader(page_number);
 	if (header.current_page_number == Page::INVALID_NUMBER)
 	{
 		// Page has been deleted since it was read.
-		throw InvalidPageException(new_page_number, filename_);
+		throw InvalidPageException(page_number, filename_);
 	}
 	// Page on disk may have had its next page pointer updated since it was read;
 	// we don't modify that, but we do keep all the other modifications to the
 	// page header.
 	const PageId next_page_number = header.next_page_number;
-	header = new_page.header_;
+	header = page.header_;
 	header.next_page_number = next_page_number;
-	writePage(new_page_number, header, new_page);
+	return header;
+}
+
+void PageFile::pageImage(const PageId page_number, const Page& page, char* image) const {
+  const PageHeader header = headerForWrite(page_number, page);
+  std::memcpy(image, &header, sizeof(PageHeader));
+  std::memcpy(image + sizeof(PageHeader), &page.data_[0], Page::DATA_SIZE);
+}
+
+bool PageFile::pageFromImage(const PageId page_number, const char* image, Page& page) const {
+  std::memcpy(&page.header_, image, sizeof(PageHeader));
+  std::memcpy(&page.data_[0], image + sizeof(PageHeader), Page::DATA_SIZE);
+  return page.isUsed();
 }
 
 void PageFile::deletePage(const PageId page_number) {
+  std::lock_guard<std::recursive_mutex> guard(open_file_->mutex);
   FileHeader header = readHeader();
 
   Page existing_page = readPage(page_number);
-  Page previous_page;
-  // If this page is the head of the used list, update the header to point to
-  // the next page in line.
-  if (page_number == header.first_used_page) {
+  // Unlink the page from the used list: either the header or the closest used
+  // page before it points to it.
+  const PageId previous_page_number = previousUsedPage(page_number);
+  if (previous_page_number == Page::INVALID_NUMBER) {
     header.first_used_page = existing_page.next_page_number();
   } else {
-    // Walk the used list so we can update the page that points to this one.
-    for (FileIterator iter = begin(); iter != end(); ++iter) {
-      previous_page = *iter;
-      if (previous_page.next_page_number() == existing_page.page_number()) {
-        previous_page.set_next_page_number(existing_page.next_page_number());
-        break;
-      }
-    }
+    PageHeader previous_header = readPageHeader(previous_page_number);
+    previous_header.next_page_number = existing_page.next_page_number();
+    writePageHeader(previous_page_number, previous_header);
   }
-  // Clear the page and add it to the head of the free list.
-  existing_page.initialize();
-  existing_page.set_next_page_number(header.first_free_page);
-  header.first_free_page = page_number;
-  ++header.num_free_pages;
-  if (previous_page.isUsed()) {
-    writePage(previous_page.page_number(), previous_page.header_, previous_page);
+  if (header.last_used_page == page_number) {
+    header.last_used_page = previous_page_number;
   }
+  // Clear the page and mark it free in the directory.
+  existing_page.initialize();
   writePage(page_number, existing_page.header_, existing_page);
+  setUsed(page_number, false);
+  if (header.num_free_pages == 0 || page_number < header.first_free_page) {
+    header.first_free_page = page_number;
+  }
+  ++header.num_free_pages;
   writeHeader(header);
 }
 
@@ -315,32 +747,40 @@ FileIterator PageFile::end() {
 
 void PageFile::writePage(const PageId page_number, const PageHeader& header,
                      const Page& new_page) {
-  stream_->seekp(pagePosition(page_number), std::ios::beg);
-  stream_->write(reinterpret_cast<const char*>(&header), sizeof(PageHeader));
-  stream_->write(&new_page.data_[0], Page::DATA_SIZE);
-  stream_->flush();
+  // one write, so a concurrent reader never sees the header without the data;
+  // aligned so that direct I/O can write it as it is
+  alignas(File::DIRECT_IO_ALIGNMENT) char image[Page::SIZE];
+  std::memcpy(image, &header, sizeof(PageHeader));
+  std::memcpy(image + sizeof(PageHeader), &new_page.data_[0], Page::DATA_SIZE);
+  writeAt(image, Page::SIZE, pagePosition(page_number));
 }
 
 PageHeader PageFile::readPageHeader(PageId page_number) const {
+  // under the mutex, so the links read are never halfway through a change
+  std::lock_guard<std::recursive_mutex> guard(open_file_->mutex);
   PageHeader header;
-  stream_->seekg(pagePosition(page_number), std::ios::beg);
-  stream_->read(reinterpret_cast<char*>(&header), sizeof(PageHeader));
+  readAt(&header, sizeof(PageHeader), pagePosition(page_number));
   return header;
 }
 
+void PageFile::writePageHeader(const PageId page_number, const PageHeader& header) {
+  std::lock_guard<std::recursive_mutex> guard(open_file_->mutex);
+  writeAt(&header, sizeof(PageHeader), pagePosition(page_number));
+}
 
 
 
-BlobFile BlobFile::create(const std::string& filename) {
-  return BlobFile(filename, true /* create_new */);
+
+BlobFile BlobFile::create(const std::string& filename, const bool direct_io) {
+  return BlobFile(filename, true /* create_new */, direct_io);
 }
 
-BlobFile BlobFile::open(const std::string& filename) {
-  return BlobFile(filename, false /* create_new */);
+BlobFile BlobFile::open(const std::string& filename, const bool direct_io) {
+  return BlobFile(filename, false /* create_new */, direct_io);
 }
 
-BlobFile::BlobFile(const std::string& name, const bool create_new)
-: File(name, create_new) {
+BlobFile::BlobFile(const std::string& name, const bool create_new, const bool direct_io)
+: File(name, create_new, direct_io) {
 }
 
 BlobFile::~BlobFile() {
@@ -360,35 +800,48 @@ BlobFile& BlobFile::operator=(const BlobFile& rhs) {
   return *this;
 }
 
-Page BlobFile::allocatePage(PageId &new_page_number) {
-  FileHeader header = readHeader();
+Page BlobFile::allocatePage(PageId &new_page_number, const PageId near) {
 	Page new_page;
+	allocatePageInto(new_page_number, new_page, near);
+	return new_page;
+}
 
-	new_page_number = header.num_pages;
+void BlobFile::allocatePageInto(PageId &new_page_number, Page& new_page, const PageId near) {
+  std::lock_guard<std::recursive_mutex> guard(open_file_->mutex);
+  FileHeader header = readHeader();
+	new_page.initialize();
+
+	new_page_number = claimPage(header, near);
 
 	if (header.first_used_page == Page::INVALID_NUMBER) {
-		header.first_used_page = header.num_pages;
+		header.first_used_page = new_page_number;
 	}
 
-	++header.num_pages;
-
 	writePage(new_page_number, new_page);
 	writeHeader(header);
-
-	return new_page;
 }
 
 Page BlobFile::readPage(const PageId page_number) const {
 	Page page;
-	stream_->seekg(pagePosition(page_number), std::ios::beg);
-	stream_->read(reinterpret_cast<char*>(&page), Page::SIZE);
+	readPageInto(page_number, page);
 	return page;
 }
 
+void BlobFile::readPageInto(const PageId page_number, Page& page) const {
+	readAt(&page, Page::SIZE, pagePosition(page_number));
+}
+
 void BlobFile::writePage(const PageId new_page_number, const Page& new_page) {
-	stream_->seekp(pagePosition(new_page_number), std::ios::beg);
-	stream_->write(reinterpret_cast<const char*>(&new_page), Page::SIZE);
-	stream_->flush();
+	writeAt(&new_page, Page::SIZE, pagePosition(new_page_number));
+}
+
+void BlobFile::pageImage(const PageId page_number, const Page& page, char* image) const {
+	std::memcpy(image, &page, Page::SIZE);
+}
+
+bool BlobFile::pageFromImage(const PageId page_number, const char* image, Page& page) const {
+	std::memcpy(&page, image, Page::SIZE);
+	return true;
 }
 
 //delePage should not be called for a blob_file, not supported
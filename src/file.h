@@ -7,10 +7,14 @@
 
 #pragma once
 
-#include <fstream>
+#include <atomic>
+#include <ios>
 #include <string>
 #include <map>
 #include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
 
 #include "page.h"
 
@@ -18,12 +22,23 @@ namespace badgerdb {
 
 class FileIterator;
 
+/**
+ * @brief What a file holds. Decides the buffer pool a file uses unless it is bound to one explicitly, and the
+ * group its buffer statistics are counted in.
+ */
+enum FileRole
+{
+	HEAP_FILE = 0,		/* relation pages, read through FileScan */
+	INDEX_FILE = 1		/* B+ tree index pages */
+};
+
 /**
  * @brief Header metadata for files on disk which contain pages.
  */
 struct FileHeader {
   /**
-   * Number of pages allocated in the file.
+   * Number of pages allocated in the file, plus one. Grows a whole extent at a
+   * time.
    */
   PageId num_pages;
 
@@ -33,15 +48,21 @@ struct FileHeader {
   PageId first_used_page;
 
   /**
-   * Number of free pages (allocated but unused) in the file.
+   * Number of free pages (allocated but unused) in the file, including the
+   * unused pages of the last extent.
    */
   PageId num_free_pages;
 
   /**
-   * Page number of the first free (allocated but unused) page in the file.
+   * Page number of the lowest free (allocated but unused) page in the file.
    */
   PageId first_free_page;
 
+  /**
+   * Page number of the last used page in the file, the tail of the used list.
+   */
+  PageId last_used_page;
+
   /**
    * Returns true if this file header is equal to the other.
    *
@@ -52,7 +73,8 @@ struct FileHeader {
     return num_pages == rhs.num_pages &&
         num_free_pages == rhs.num_free_pages &&
         first_used_page == rhs.first_used_page &&
-        first_free_page == rhs.first_free_page;
+        first_free_page == rhs.first_free_page &&
+        last_used_page == rhs.last_used_page;
   }
 };
 
@@ -60,32 +82,83 @@ struct FileHeader {
  * @brief Class which represents a file in the filesystem containing database
  *        pages.
  *
- * The File class wraps a stream to an underlying file on disk.  Files contain
- * fixed-sized pages, and they never deallocate space (though they do reuse
- * deleted pages if possible).  If multiple File objects refer to the same
- * underlying file, they will share the stream in memory.
+ * The File class wraps a descriptor of an underlying file on disk.  Files
+ * contain fixed-sized pages, and they never deallocate space (though they do
+ * reuse deleted pages if possible).  If multiple File objects refer to the
+ * same underlying file, they will share the descriptor.
+ *
+ * Files grow by extents of EXTENT_PAGES pages, written out in one go when the
+ * file runs out of free pages. Which pages are in use is recorded in a page
+ * directory, a bitmap with one bit per page, split into directory blocks of
+ * Page::SIZE bytes that each cover the DIRECTORY_SPAN pages stored right after
+ * them; directory blocks have no page number of their own. A new page goes to
+ * a free page in the extent of the page given as a hint, if there is one, so
+ * pages that are read together end up next to each other on disk, and
+ * otherwise to the lowest free page.
  * If a file that has already been opened (possibly by another query), then the File class
- * detects this (by looking in the open_streams_ map) and just returns a file object with
- * the already created stream for the file without actually opening the UNIX file again. 
+ * detects this (by looking in the open_files_ map) and just returns a file object with
+ * the already open descriptor for the file without actually opening the UNIX file again.
+ *
+ * Pages are read and written with positional I/O (pread/pwrite), which has no
+ * shared file position, so File objects may be used from several threads at
+ * once and reads of the same file run concurrently. Only changes to the file
+ * header, the page directory and the links between pages, and writes that
+ * depend on them, are serialized, by a mutex per open file; the open_files_
+ * registry has a mutex of its own.
  *
- * @warning This class is not threadsafe.
+ * The file header is shared along with the descriptor: it is read once when
+ * the file is opened, kept in memory and written back by sync() and when the
+ * last File object on the file closes it, instead of being read and written
+ * on every page operation. After a crash the header on disk may lag behind
+ * the extents and the page directory; recoverHeader() rebuilds it from them.
+ *
+ * A file can be opened for direct I/O (O_DIRECT), bypassing the operating
+ * system's page cache so that the buffer pool is the only copy of a page in
+ * memory. Transfers then have to be aligned to DIRECT_IO_ALIGNMENT in memory,
+ * in position and in size. The header takes a whole page and page positions
+ * are multiples of Page::SIZE, so page reads and writes into buffer pool
+ * frames, which are aligned, go straight to disk; smaller or unaligned
+ * transfers, such as header and directory updates, go through an aligned
+ * block that is read, patched and written back. Whether a file uses direct
+ * I/O is decided by the File object that opens it; File objects opened on it
+ * later share its descriptor and its mode.
  */
 
 
 class File {
  public:
+  /**
+   * Number of pages a file grows by when it runs out of free pages.
+   */
+  static const PageId EXTENT_PAGES = 64;
+
+  /**
+   * Number of pages each directory block covers.
+   */
+  static const PageId DIRECTORY_SPAN = Page::SIZE * 8;
+
+  /**
+   * Alignment of memory, positions and sizes of transfers to and from a file
+   * opened for direct I/O.
+   */
+  static const std::size_t DIRECT_IO_ALIGNMENT = 4096;
 
   /**
    * Constructs a file object representing a file on the filesystem.
    *
    * @param name        Name of file.
    * @param create_new  Whether to create a new file.
+   * @param direct_io   Whether to bypass the operating system's page cache,
+   *                    if this object is the one that opens the file.
    * @throws  FileExistsException     If the underlying file exists and
    *                                  create_new is true.
    * @throws  FileNotFoundException   If the underlying file doesn't exist and
    *                                  create_new is false.
+   * @throws  FileIOException         If the file can not be opened, such as
+   *                                  for direct I/O on a filesystem that does
+   *                                  not support it.
    */
-  File(const std::string& name, const bool create_new);
+  File(const std::string& name, const bool create_new, const bool direct_io = false);
 
   /**
    * Deletes an existing file.
@@ -111,6 +184,14 @@ class File {
    */
   static bool exists(const std::string& filename);
 
+  /**
+   * Forces every open file that has been written since it was last synced to
+   * stable storage. Files closed in the meantime were synced when they closed.
+   *
+   * @throws  FileIOException   If a file can not be synced.
+   */
+  static void syncAll();
+
   /**
    * Destructor that automatically closes the underlying file if no other
    * File objects are using it.
@@ -120,9 +201,25 @@ class File {
   /**
    * Allocates a new page in the file.
    *
+   * @param new_page_number   Receives the number of the new page.
+   * @param near              Page the new one will be read together with,
+   *                          such as its sibling in an index; the new page is
+   *                          placed in the same extent if it has a free page.
    * @return The new page.
    */
-  virtual Page allocatePage(PageId &new_page_number) = 0;
+  virtual Page allocatePage(PageId &new_page_number,
+                            const PageId near = Page::INVALID_NUMBER) = 0;
+
+  /**
+   * Allocates a new page in the file, like allocatePage(), but builds it in
+   * the given page instead of returning a copy.
+   *
+   * @param new_page_number   Receives the number of the new page.
+   * @param new_page          Overwritten with the new page.
+   * @param near              Page to place the new one next to, if possible.
+   */
+  virtual void allocatePageInto(PageId &new_page_number, Page& new_page,
+                                const PageId near = Page::INVALID_NUMBER) = 0;
 
   /**
    * Reads an existing page from the file.
@@ -134,15 +231,71 @@ class File {
    */
   virtual Page readPage(const PageId page_number) const = 0;
 
+  /**
+   * Reads an existing page from the file, like readPage(), but straight into
+   * the given page instead of returning a copy.
+   *
+   * @param page_number   Number of page to read.
+   * @param page          Overwritten with the page; undefined if the read fails.
+   * @throws  InvalidPageException  If the page doesn't exist in the file or is
+   *                                not currently used.
+   */
+  virtual void readPageInto(const PageId page_number, Page& page) const = 0;
+
   /**
    * Writes a page into the file at the given page number.
-   * No bounds checking is performed.
+   * No bounds checking is performed. The write may stay in the operating
+   * system's cache; call sync() to make it durable.
    *
    * @param page_number Number of page whose contents to replace.
    * @param new_page    Page to write.
    */
   virtual void writePage(const PageId page_number, const Page& new_page) = 0;
 
+  /**
+   * Writes a batch of pages. The pages are written in page number order and
+   * each run of consecutive page numbers goes out in a single write, so the
+   * batch may be given in any order. Like writePage() nothing is flushed;
+   * call sync() once the batch is complete.
+   *
+   * If a page can not be written, the runs before it have been written and
+   * the exception propagates.
+   *
+   * @param pages   Page numbers paired with the pages to write there.
+   * @throws  InvalidPageException  If a page has been deleted from a PageFile.
+   */
+  void writePages(const std::vector<std::pair<PageId, const Page*> >& pages);
+
+  /**
+   * Reads count consecutive pages, starting at first, with a single read.
+   * Pages past the end of the file and, in a PageFile, free pages are left
+   * out of the result.
+   *
+   * @param first   Number of the first page to read.
+   * @param count   Number of pages to read.
+   * @param pages   Receives the numbers of the pages read paired with their
+   *                contents, in page number order.
+   */
+  void readPages(const PageId first, const std::uint32_t count,
+                 std::vector<std::pair<PageId, Page> >& pages) const;
+
+  /**
+   * Writes back the file header and forces the file's contents to stable
+   * storage.
+   *
+   * @throws  FileIOException   If the file can not be synced.
+   */
+  void sync();
+
+  /**
+   * Rebuilds the header from the size of the file and the page directory, and
+   * writes it back. Meant for restart after a crash, when the header on disk
+   * may predate extents and pages allocated since it was last written.
+   *
+   * @throws  FileIOException   If the file can not be read or written.
+   */
+  void recoverHeader();
+
   /**
    * Deletes a page from the file.
    *
@@ -150,6 +303,11 @@ class File {
    */
   virtual void deletePage(const PageId page_number) = 0;
 
+  /**
+   * Returns true if the file bypasses the operating system's page cache.
+   */
+  bool directIO() const;
+
   /**
    * Returns the name of the file this object represents.
    *
@@ -157,6 +315,13 @@ class File {
    */
   const std::string& filename() const { return filename_; }
 
+  /**
+   * Returns what the file holds.
+   *
+   * @return  HEAP_FILE for a PageFile, INDEX_FILE for a BlobFile.
+   */
+  virtual FileRole role() const = 0;
+
  	/**
    * Returns pageid of first page in the file.
    *
@@ -164,78 +329,269 @@ class File {
    */
 	PageId getFirstPageNo();
 
+  /**
+   * Returns the number of pages allocated in the file, used or free. Pages
+   * are numbered from 1 up to this number.
+   *
+   * @return  Number of pages in the file.
+   */
+  PageId getNumPages();
+
+  /**
+   * Returns the number of pages in use in the file.
+   *
+   * @return  Number of used pages.
+   */
+  PageId getNumUsedPages();
+
  protected:
   /**
    * Returns the position of the page with the given number in the file (as an
-   * offset from the beginning of the file).
+   * offset from the beginning of the file), leaving room for the header page
+   * and for the directory block in front of every DIRECTORY_SPAN pages.
    *
    * @param page_number   Number of page.
    * @return  Position of page in file.
    */
   static std::streampos pagePosition(const PageId page_number) {
-    return sizeof(FileHeader) + ((page_number - 1) * Page::SIZE);
+    return (std::streamoff(page_number - 1) + (page_number - 1) / DIRECTORY_SPAN + 2) * Page::SIZE;
   }
 
+  /**
+   * Returns the position in the file of the directory block covering the
+   * given page.
+   *
+   * @param page_number   Number of page.
+   * @return  Position of the directory block in file.
+   */
+  static std::streampos directoryPosition(const PageId page_number) {
+    return (std::streamoff((page_number - 1) / DIRECTORY_SPAN) * (DIRECTORY_SPAN + 1) + 1) * Page::SIZE;
+  }
+
+  /**
+   * Picks a free page for a new page, growing the file by an extent if there
+   * is none, and marks it used in the page directory. Updates the page counts
+   * in the header but does not write it.
+   *
+   * @param header  Header of the file, updated for the new page.
+   * @param near    Page whose extent to prefer, or Page::INVALID_NUMBER.
+   * @return  Number of the new page.
+   */
+  PageId claimPage(FileHeader& header, const PageId near);
+
+  /**
+   * Marks a page as used or free in the page directory.
+   *
+   * @param page_number   Number of page.
+   * @param used          Whether the page is now used.
+   */
+  void setUsed(const PageId page_number, const bool used);
+
+  /**
+   * Finds the lowest free page numbered from first up to, not including,
+   * limit by searching the page directory.
+   *
+   * @param first   Number of the first page to consider.
+   * @param limit   Number of the first page not to consider.
+   * @return  Number of the free page, or Page::INVALID_NUMBER if there is none.
+   */
+  PageId nextFreePage(const PageId first, const PageId limit) const;
+
+  /**
+   * Finds the used page with the highest number below the given one by
+   * searching the page directory backwards.
+   *
+   * @param page_number   Number of page.
+   * @return  Number of the preceding used page, or Page::INVALID_NUMBER if
+   *          there is none.
+   */
+  PageId previousUsedPage(const PageId page_number) const;
+
+  /**
+   * A directory block kept between calls of nextUsedPage().
+   */
+  struct DirectoryBlock {
+    /**
+     * First page the block covers, Page::INVALID_NUMBER if none is held.
+     */
+    PageId first_page;
+
+    /**
+     * The block's bits for the pages that existed when it was read.
+     */
+    std::vector<unsigned char> bits;
+  };
+
+  /**
+   * Finds the used page with the lowest number above the given one by
+   * searching the page directory forwards. The directory block searched is
+   * kept in block, and read again only for pages it does not cover, so
+   * stepping through a file with the same block reads each directory block
+   * once.
+   *
+   * @param page_number   Number of page.
+   * @param block         Directory block from the previous call.
+   * @return  Number of the following used page, or Page::INVALID_NUMBER if
+   *          there is none.
+   */
+  PageId nextUsedPage(const PageId page_number, DirectoryBlock& block) const;
+
+  /**
+   * Fills image with the Page::SIZE bytes writePages() should store for the
+   * given page.
+   *
+   * @param page_number   Number of the page being written.
+   * @param page          Page to write.
+   * @param image         Buffer of Page::SIZE bytes receiving the on-disk image.
+   */
+  virtual void pageImage(const PageId page_number, const Page& page, char* image) const = 0;
+
+  /**
+   * Fills page from the Page::SIZE bytes stored on disk for the given page,
+   * the reverse of pageImage().
+   *
+   * @param page_number   Number of the page being read.
+   * @param image         On-disk image of the page.
+   * @param page          Page receiving the contents.
+   * @return  False if the page is not one readPage() would return.
+   */
+  virtual bool pageFromImage(const PageId page_number, const char* image, Page& page) const = 0;
+
+  /**
+   * Maximum number of pages writePages() puts in a single write.
+   */
+  static const std::size_t MAX_WRITE_RUN = 64;
+
   /**
    * Opens the underlying file named in filename_.
    * This method only opens the file if no other File objects exist that access
-   * the same filesystem file; otherwise, it reuses the existing stream.
+   * the same filesystem file; otherwise, it reuses the existing descriptor.
    *
    * @param create_new  Whether to create a new file.
    * @throws  FileExistsException     If the underlying file exists and
    *                                  create_new is true.
+   * @param direct_io   Whether to open the file for direct I/O.
    * @throws  FileNotFoundException   If the underlying file doesn't exist and
    *                                  create_new is false.
+   * @throws  FileIOException         If the file can not be opened.
    */
-  void openIfNeeded(const bool create_new);
+  void openIfNeeded(const bool create_new, const bool direct_io = false);
 
   /**
-   * Closes the underlying file stream in <stream_>.
+   * Closes the underlying file descriptor in <open_file_>.
    * This method only closes the file if no other File objects exist that access
-   * the same file.
+   * the same file, and syncs it first if it has been written since it was last
+   * synced.
    */
   void close();
 
   /**
-   * Reads the header for this file from disk.
+   * Returns the header for this file, from memory.
    *
    * @return  The file header.
    */
   FileHeader readHeader() const;
 
   /**
-   * Writes the given header to the disk as the header for this file.
+   * Replaces the header for this file in memory. It reaches the disk with the
+   * next flushHeader().
    *
    * @param header  File header to write.
    */
   void writeHeader(const FileHeader& header);
 
-  typedef std::map<std::string, std::shared_ptr<std::fstream> > StreamMap;
+  /**
+   * Writes the header to disk if it has changed since it was last written.
+   */
+  void flushHeader();
+
+  /**
+   * Reads size bytes at the given position of the file. Bytes past the end of
+   * the file read as zeroes. In direct I/O mode a transfer that is not
+   * aligned goes through an aligned block.
+   *
+   * @throws  FileIOException   If the read fails.
+   */
+  void readAt(void* buffer, const std::size_t size, const std::streampos position) const;
+
+  /**
+   * Writes size bytes at the given position of the file. In direct I/O mode a
+   * transfer that is not aligned goes through an aligned block, read first if
+   * the transfer covers it only in part; callers of such writes hold the
+   * file's mutex.
+   *
+   * @throws  FileIOException   If the write fails.
+   */
+  void writeAt(const void* buffer, const std::size_t size, const std::streampos position) const;
+
+  /**
+   * State shared by all File objects open on the same file.
+   */
+  struct OpenFile {
+    /**
+     * Descriptor of the file, and whether it was opened for direct I/O.
+     */
+    int fd;
+    bool direct_io;
+
+    /**
+     * True once the file has been written to since it was last synced.
+     */
+    std::atomic<bool> unsynced;
+
+    /**
+     * Current header of the file, and whether it differs from the one on disk.
+     */
+    FileHeader header;
+    bool header_dirty;
+
+    /**
+     * Serializes changes to the header, the page directory and the links
+     * between pages. Recursive because multi-step operations such as
+     * allocatePage() hold it across the steps they are built from.
+     */
+    std::recursive_mutex mutex;
+  };
+
+  typedef std::map<std::string, std::shared_ptr<OpenFile> > FileMap;
   typedef std::map<std::string, int> CountMap;
 
   /**
-   * Streams for opened files.
+   * Descriptors and headers for opened files.
    */
-  static StreamMap open_streams_;
+  static FileMap open_files_;
 
   /**
    * Counts for opened files.
    */
   static CountMap open_counts_;
 
+  /**
+   * Serializes use of the two maps above.
+   */
+  static std::recursive_mutex registry_mutex_;
+
   /**
    * Name of the file this object represents.
    */
   std::string filename_;
 
   /**
-   * Stream for underlying filesystem object.
+   * Shared state of the file.
    */
-  std::shared_ptr<std::fstream> stream_;
+  std::shared_ptr<OpenFile> open_file_;
 
   friend class FileIterator;
 };
 
+/**
+ * @brief A File of slotted pages, linked into a list of used pages in page
+ *        number order.
+ *
+ * With the page directory and the tail pointer in the file header, allocating
+ * and deleting a page touch only the page, its predecessor in the used list
+ * and the header, instead of walking the used list.
+ */
 class PageFile : public File {
  public:
 
@@ -243,33 +599,37 @@ class PageFile : public File {
    * Creates a new file.
    *
    * @param filename  Name of the file.
+   * @param direct_io Whether to bypass the operating system's page cache.
    * @throws  FileExistsException     If the requested file already exists.
    */
-  static PageFile create(const std::string& filename);
+  static PageFile create(const std::string& filename, const bool direct_io = false);
 
   /**
    * Opens the file named fileName and returns the corresponding File object.
-	 * It first checks if the file is already open. If so, then the new File object created uses the same input-output stream to read to or write fom
+	 * It first checks if the file is already open. If so, then the new File object created uses the same descriptor to read to or write fom
 	 * that already open file. Reference count (open_counts_ static variable inside the File object) is incremented whenever an already open file is
-	 * opened again. Otherwise the UNIX file is actually opened. The fileName and the stream associated with this File object are inserted into the
-	 * open_streams_ map.
+	 * opened again. Otherwise the UNIX file is actually opened. The fileName and the descriptor associated with this File object are inserted into the
+	 * open_files_ map.
    *
    * @param filename  Name of the file.
+   * @param direct_io Whether to bypass the operating system's page cache, if
+   *                  the file is not open already.
    * @throws  FileNotFoundException   If the requested file doesn't exist.
    */
-  static PageFile open(const std::string& filename);
+  static PageFile open(const std::string& filename, const bool direct_io = false);
 
   /**
    * Constructs a file object representing a file on the filesystem.
    *
    * @param name        Name of file.
    * @param create_new  Whether to create a new file.
+   * @param direct_io   Whether to bypass the operating system's page cache.
    * @throws  FileExistsException     If the underlying file exists and
    *                                  create_new is true.
    * @throws  FileNotFoundException   If the underlying file doesn't exist and
    *                                  create_new is false.
    */
-  PageFile(const std::string& name, const bool create_new);
+  PageFile(const std::string& name, const bool create_new, const bool direct_io = false);
 
   /**
    * Copy constructor.
@@ -298,7 +658,14 @@ class PageFile : public File {
    *
    * @return The new page.
    */
-  Page allocatePage(PageId &new_page_number) override;
+  Page allocatePage(PageId &new_page_number,
+                    const PageId near = Page::INVALID_NUMBER) override;
+
+  /**
+   * Allocates a new page in the file, building it in new_page.
+   */
+  void allocatePageInto(PageId &new_page_number, Page& new_page,
+                        const PageId near = Page::INVALID_NUMBER) override;
 
   /**
    * Reads an existing page from the file.
@@ -310,6 +677,14 @@ class PageFile : public File {
    */
   Page readPage(const PageId page_number) const override;
 
+  /**
+   * Reads an existing page from the file straight into page.
+   *
+   * @throws  InvalidPageException  If the page doesn't exist in the file or is
+   *                                not currently used.
+   */
+  void readPageInto(const PageId page_number, Page& page) const override;
+
   /**
    * Writes a page into the file at the given page number.
    * No bounds checking is performed.
@@ -326,6 +701,8 @@ class PageFile : public File {
    */
   void deletePage(const PageId page_number) override;
 
+  FileRole role() const override { return HEAP_FILE; }
+
   /**
    * Returns an iterator at the first page in the file.
    *
@@ -341,14 +718,30 @@ class PageFile : public File {
    */
   FileIterator end();
 
+ protected:
+  void pageImage(const PageId page_number, const Page& page, char* image) const override;
+  bool pageFromImage(const PageId page_number, const char* image, Page& page) const override;
+
  private:
 
+  /**
+   * Returns the header to write for the given page: the header of the page in
+   * memory, except for the next page pointer, which is kept from disk because
+   * the used list may have changed since the page was read.
+   *
+   * @param page_number   Number of page being written.
+   * @param page          Page to write.
+   * @return  Header to write.
+   * @throws  InvalidPageException  If the page has been deleted since it was read.
+   */
+  PageHeader headerForWrite(const PageId page_number, const Page& page) const;
+
   /**
    * Reads a page from the file.  If <allow_free> is not set, an exception
    * will be thrown if the page read from disk is not currently in use.
    *
-   * No bounds checking is performed; the underlying file stream will throw
-   * an exception if the page is past the end of the file.
+   * No bounds checking is performed; a page past the end of the file reads
+   * as a free page.
    *
    * @param page_number   Number of page to read.
    * @param allow_free    Whether to allow reading a free (unused) page.
@@ -358,6 +751,11 @@ class PageFile : public File {
    */
   Page readPage(const PageId page_number, const bool allow_free) const;
 
+  /**
+   * Reads a page straight into page, like readPage(page_number, allow_free).
+   */
+  void readPageInto(const PageId page_number, const bool allow_free, Page& page) const;
+
   /**
    * Writes a page into the file at the given page number with the given header.
    * This does not ensure that the number in the header equals the position on
@@ -379,6 +777,15 @@ class PageFile : public File {
    */
   PageHeader readPageHeader(const PageId page_number) const;
 
+  /**
+   * Writes only the header of the given page to disk, leaving the rest of the
+   * page as it is.  No bounds checking is performed.
+   *
+   * @param page_number   Number of page whose header is to be written.
+   * @param header        Header to write.
+   */
+  void writePageHeader(const PageId page_number, const PageHeader& header);
+
   friend class FileIterator;
 };
 
@@ -389,21 +796,24 @@ class BlobFile : public File {
    * Creates a new BlobFile.
    *
    * @param filename  Name of the file.
+   * @param direct_io Whether to bypass the operating system's page cache.
    * @throws  FileExistsException     If the requested file already exists.
    */
-  static BlobFile create(const std::string& filename);
+  static BlobFile create(const std::string& filename, const bool direct_io = false);
 
   /**
    * Opens the file named fileName and returns the corresponding File object.
-	 * It first checks if the file is already open. If so, then the new File object created uses the same input-output stream to read to or write fom
+	 * It first checks if the file is already open. If so, then the new File object created uses the same descriptor to read to or write fom
 	 * that already open file. Reference count (open_counts_ static variable inside the File object) is incremented whenever an already open file is
-	 * opened again. Otherwise the UNIX file is actually opened. The fileName and the stream associated with this File object are inserted into the
-	 * open_streams_ map.
+	 * opened again. Otherwise the UNIX file is actually opened. The fileName and the descriptor associated with this File object are inserted into the
+	 * open_files_ map.
    *
    * @param filename  Name of the file.
+   * @param direct_io Whether to bypass the operating system's page cache, if
+   *                  the file is not open already.
    * @throws  FileNotFoundException   If the requested file doesn't exist.
    */
-  static BlobFile open(const std::string& filename);
+  static BlobFile open(const std::string& filename, const bool direct_io = false);
 
   /**
    * Constructs a file object representing a file on the filesystem.
@@ -412,12 +822,13 @@ class BlobFile : public File {
    * @see File::open()
    * @param name        Name of file.
    * @param create_new  Whether to create a new file.
+   * @param direct_io   Whether to bypass the operating system's page cache.
    * @throws  FileExistsException     If the underlying file exists and
    *                                  create_new is true.
    * @throws  FileNotFoundException   If the underlying file doesn't exist and
    *                                  create_new is false.
    */
-  BlobFile(const std::string& name, const bool create_new);
+  BlobFile(const std::string& name, const bool create_new, const bool direct_io = false);
 
   /**
    * Copy constructor.
@@ -446,7 +857,14 @@ class BlobFile : public File {
    *
    * @return The new page.
    */
-  Page allocatePage(PageId &new_page_number) override;
+  Page allocatePage(PageId &new_page_number,
+                    const PageId near = Page::INVALID_NUMBER) override;
+
+  /**
+   * Allocates a new page in the file, building it in new_page.
+   */
+  void allocatePageInto(PageId &new_page_number, Page& new_page,
+                        const PageId near = Page::INVALID_NUMBER) override;
 
   /**
    * Reads an existing page from the file.
@@ -458,6 +876,14 @@ class BlobFile : public File {
    */
   Page readPage(const PageId page_number) const override;
 
+  /**
+   * Reads an existing page from the file straight into page.
+   *
+   * @throws  InvalidPageException  If the page doesn't exist in the file or is
+   *                                not currently used.
+   */
+  void readPageInto(const PageId page_number, Page& page) const override;
+
   /**
    * Writes a page into the file at the given page number.
    * No bounds checking is performed.
@@ -473,6 +899,12 @@ class BlobFile : public File {
    * @param page_number   Number of page to delete.
    */
   void deletePage(const PageId page_number) override;
+
+  FileRole role() const override { return INDEX_FILE; }
+
+ protected:
+  void pageImage(const PageId page_number, const Page& page, char* image) const override;
+  bool pageFromImage(const PageId page_number, const char* image, Page& page) const override;
 };
 
 }
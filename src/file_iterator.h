@@ -19,6 +19,14 @@ namespace badgerdb {
  *
  * This class provides a forward-only iterator for iterating over all of the
  * pages in a file.
+ *
+ * The iterator only holds a page number. Callers that read the pages through
+ * a buffer pool should take the number from page_number() rather than
+ * dereferencing the iterator, which reads the whole page from the file.
+ * operator++ finds the next used page in the file's page directory. The
+ * iterator keeps the directory block it last read, so a scan reads one block
+ * per File::DIRECTORY_SPAN pages rather than anything per page. Pages
+ * allocated in that block after it was read may be passed over.
  */
 class FileIterator {
  public:
@@ -28,6 +36,7 @@ class FileIterator {
   FileIterator()
       : file_(NULL),
         current_page_number_(Page::INVALID_NUMBER) {
+    directory_.first_page = Page::INVALID_NUMBER;
   }
 
   /**
@@ -41,6 +50,7 @@ class FileIterator {
     assert(file_ != NULL);
     const FileHeader& header = file_->readHeader();
     current_page_number_ = header.first_used_page;
+    directory_.first_page = Page::INVALID_NUMBER;
   }
 
   /**
@@ -53,15 +63,15 @@ class FileIterator {
   FileIterator(PageFile* file, PageId page_number)
       : file_(file),
         current_page_number_(page_number) {
+    directory_.first_page = Page::INVALID_NUMBER;
   }
 
   /**
-   * Advances the iterator to the next page in the file.
+   * Advances the iterator to the next used page in the file.
    */
 	inline FileIterator& operator++() {
     assert(file_ != NULL);
-    const PageHeader& header = file_->readPageHeader(current_page_number_);
-    current_page_number_ = header.next_page_number;
+    current_page_number_ = file_->nextUsedPage(current_page_number_, directory_);
 
 		return *this;
 	}
@@ -72,8 +82,7 @@ class FileIterator {
 		FileIterator tmp = *this;   // copy ourselves
 
     assert(file_ != NULL);
-    const PageHeader& header = file_->readPageHeader(current_page_number_);
-    current_page_number_ = header.next_page_number;
+    current_page_number_ = file_->nextUsedPage(current_page_number_, directory_);
 
 		return tmp;
 	}
@@ -85,18 +94,26 @@ class FileIterator {
    * @return    True if other iterator is equal to this one.
    */
 	inline bool operator==(const FileIterator& rhs) const {
-    return file_->filename() == rhs.file_->filename() &&
-        current_page_number_ == rhs.current_page_number_;
+    // Only compare file names for iterators from different File objects.
+    return current_page_number_ == rhs.current_page_number_ &&
+        (file_ == rhs.file_ || file_->filename() == rhs.file_->filename());
   }
 
 	inline bool operator!=(const FileIterator& rhs) const {
-    return (file_->filename() != rhs.file_->filename()) ||
-        (current_page_number_ != rhs.current_page_number_);
+    return !(*this == rhs);
   }
 
   /**
-   * Dereferences the iterator, returning a copy of the current page in the
-   * file.
+   * Returns the number of the current page, without reading it.
+   *
+   * @return  Page number, or Page::INVALID_NUMBER at the end of the file.
+   */
+	inline PageId page_number() const
+  { return current_page_number_; }
+
+  /**
+   * Dereferences the iterator, returning a copy of the current page read from
+   * the file.
    *
    * @return  Page in file.
    */
@@ -113,6 +130,11 @@ class FileIterator {
    * Number of page in file iterator is currently pointing to.
    */
   PageId current_page_number_;
+
+  /**
+   * Directory block the next page was last looked up in.
+   */
+  File::DirectoryBlock directory_;
 };
 
 }
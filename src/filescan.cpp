@@ -16,15 +16,23 @@ FileScan::FileScan(const std::string &name, BufMgr *bufferMgr)
 	bufMgr = bufferMgr;
 	curDirtyFlag = false;
   curPage = NULL;
+	readAheadEnd = 0;
 	filePageIter = file->begin();
 }
 
+FileScan::FileScan(const std::string &name, BufPoolRegistry *pools)
+	: FileScan(name, pools->poolFor(name, HEAP_FILE))
+{
+}
+
 FileScan::~FileScan()
 {
   // generally must unpin last page of the scan
   if (curPage != NULL)
   {
-    bufMgr->unPinPage(file, (*filePageIter).page_number(), curDirtyFlag);
+    if (curDirtyFlag)
+      curHandle.markDirty();
+    curHandle.release();
     curPage = NULL;
 		curDirtyFlag = false;
     filePageIter = file->begin();
@@ -35,11 +43,17 @@ FileScan::~FileScan()
 
 void FileScan::scanNext(RecordId& outRid)
 {
-  std::string rec;
+  if (!tryScanNext(outRid))
+	{
+		throw EndOfFileException();
+	}
+}
 
+bool FileScan::tryScanNext(RecordId& outRid)
+{
   if (filePageIter == file->end())
 	{
-		throw EndOfFileException();
+		return false;
 	}
 
   // special case of the first record of the first page of the file
@@ -49,23 +63,22 @@ void FileScan::scanNext(RecordId& outRid)
 		filePageIter = file->begin();
     if(filePageIter == file->end())
 		{
-			throw EndOfFileException();
+			return false;
 		}
 	 
 		// read the first page of the file
-    bufMgr->readPage(file, (*filePageIter).page_number(), curPage); 
+    curHandle = bufMgr->readPage(file, filePageIter.page_number());
+    curPage = curHandle.page();
 		curDirtyFlag = false;
+		readAhead();
 
 		// get the first record off the page
     pageRecordIter = curPage->begin(); 
 
 		if(pageRecordIter != curPage->end()) 
 		{
-		  // get pointer to record
-		  rec = *pageRecordIter;
-
 			outRid = pageRecordIter.getCurrentRecord();
-			return;
+			return true;
 		}
   }
 
@@ -76,7 +89,9 @@ void FileScan::scanNext(RecordId& outRid)
   while (pageRecordIter == curPage->end())
   {
     // unpin the current page
-    bufMgr->unPinPage(file, (*filePageIter).page_number(), curDirtyFlag);
+    if (curDirtyFlag)
+      curHandle.markDirty();
+    curHandle.release();
     curPage = NULL;
     curDirtyFlag = false;
 
@@ -84,24 +99,37 @@ void FileScan::scanNext(RecordId& outRid)
     if (filePageIter == file->end())
     {
       curPage = NULL;
-			throw EndOfFileException();
+			return false;
     }
 
     // read the next page of the file
-    bufMgr->readPage(file, (*filePageIter).page_number(), curPage);
+    curHandle = bufMgr->readPage(file, filePageIter.page_number());
+    curPage = curHandle.page();
+    readAhead();
 
     // get the first record off the page
     pageRecordIter = curPage->begin(); 
   }
 
-  // curRec points at a valid record
-  // see if the record satisfies the scan's predicate 
-  // get a pointer to the record
-  rec = *pageRecordIter;
-
 	// return rid of the record
 	outRid = pageRecordIter.getCurrentRecord();
-	return;
+	return true;
+}
+
+// Used pages are kept in ascending page number order, so the pages the
+// scan visits next are the ones following the current page's successor.
+// Numbers that turn out to be free pages are skipped by the prefetcher.
+void FileScan::readAhead()
+{
+  const PageId next = curPage->next_page_number();
+  if (next == Page::INVALID_NUMBER)
+    return;
+  if (readAheadEnd >= next + READ_AHEAD_PAGES / 2)
+    return;
+
+  const PageId first = readAheadEnd > next ? readAheadEnd : next;
+  bufMgr->prefetch(file, first, next + READ_AHEAD_PAGES - first);
+  readAheadEnd = next + READ_AHEAD_PAGES;
 }
 
 // returns pointer to the current record.  page is left pinned
@@ -12,6 +12,7 @@
 #include "types.h"
 #include "page.h"
 #include "buffer.h"
+#include "pool_registry.h"
 #include "file_iterator.h"
 #include "page_iterator.h"
 
@@ -26,11 +27,17 @@ class FileScan
 
   FileScan(const std::string &name, BufMgr *bufMgr);
 
+  //scan the relation through the pool the registry assigns to it
+  FileScan(const std::string &name, BufPoolRegistry *pools);
+
   ~FileScan();
 
   //return RecordId of next record that satisfies the scan 
   void scanNext(RecordId& outRid);
 
+  //like scanNext, but returns false at the end of the file instead of throwing
+  bool tryScanNext(RecordId& outRid);
+
   //read current record, returning pointer and length
   std::string getRecord();
 
@@ -53,6 +60,11 @@ class FileScan
    */
   Page*         curPage;
 
+  /**
+   * Pin on the current page
+   */
+  PageHandle    curHandle;
+
   FileIterator  filePageIter;
   PageIterator  pageRecordIter;
 
@@ -60,6 +72,21 @@ class FileScan
    * True if page has been updated
    */
   bool  	      curDirtyFlag;
+
+  /**
+   * Number of pages past the current one the scan asks the buffer manager to prefetch
+   */
+  static const std::uint32_t READ_AHEAD_PAGES = 16;
+
+  /**
+   * First page number not yet handed to BufMgr::prefetch()
+   */
+  PageId        readAheadEnd;
+
+  /**
+   * Tops up the read-ahead window once less than half of it remains past the current page.
+   */
+  void readAhead();
 };
 
 }
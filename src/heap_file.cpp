@@ -0,0 +1,273 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include "heap_file.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+#include "file_iterator.h"
+
+namespace badgerdb {
+
+const char* const HeapFile::FSM_SUFFIX = ".fsm";
+
+namespace {
+
+/**
+ * Opens the free-space map of a relation, creating an empty one if it does not exist. A map left over from an
+ * earlier relation of the same name is dropped when the relation is created.
+ */
+BlobFile openMap(const std::string& name, const bool create_new)
+{
+  const std::string mapName = name + HeapFile::FSM_SUFFIX;
+  if (create_new && File::exists(mapName))
+    File::remove(mapName);
+  return BlobFile(mapName, !File::exists(mapName));
+}
+
+/**
+ * Writes out and drops the pages of a file that is about to be closed. Returns false, after saying why, if they
+ * could not all be dropped.
+ */
+bool flushForClose(BufMgr* bufMgr, const File* file)
+{
+  try
+  {
+    bufMgr->flushFile(file);
+    return true;
+  }
+  catch (const std::exception &e)
+  {
+    std::cerr << "HeapFile: can not close " << file->filename() << ": " << e.what() << std::endl;
+    return false;
+  }
+}
+
+}
+
+HeapFile::HeapFile(const std::string& name, BufMgr* bufMgr, const bool create_new)
+	: file(name, create_new),
+		fsmFile(openMap(name, create_new)),
+		bufMgr(bufMgr),
+		appendPageNo(Page::INVALID_NUMBER),
+		appendLevel(0),
+		fsmPages(fsmFile.getNumUsedPages()),
+		searchStart(1)
+{
+  if (fsmPages == 0 && file.getNumUsedPages() > 0)
+    rebuildMap();
+}
+
+HeapFile::HeapFile(const std::string& name, BufPoolRegistry* pools, const bool create_new)
+	: HeapFile(name, pools->poolFor(name, HEAP_FILE), create_new)
+{
+}
+
+HeapFile::~HeapFile()
+{
+  appendPage.release();
+
+  // frames left in the pool would point at the File objects destroyed with
+  // this one, so the map is flushed even if the relation can not be, and
+  // either failing is fatal
+  const bool relationFlushed = flushForClose(bufMgr, &file);
+  const bool mapFlushed = flushForClose(bufMgr, &fsmFile);
+  if (!relationFlushed || !mapFlushed)
+    std::abort();
+}
+
+void HeapFile::remove(const std::string& name)
+{
+  File::remove(name);
+  const std::string mapName = name + FSM_SUFFIX;
+  if (File::exists(mapName))
+    File::remove(mapName);
+}
+
+std::uint32_t HeapFile::levelFor(const std::uint32_t freeSpace)
+{
+  const std::uint32_t level = freeSpace / FSM_STEP;
+  return level < (1u << FSM_BITS) ? level : (1u << FSM_BITS) - 1;
+}
+
+std::uint32_t HeapFile::getLevel(const PageId pageNo)
+{
+  const PageId fsmPageNo = (pageNo - 1) / FSM_SPAN + 1;
+  if (fsmPageNo > fsmPages)
+    return 0;
+  const PageId entry = (pageNo - 1) % FSM_SPAN;
+  PageHandle fsmPage = bufMgr->readPage(&fsmFile, fsmPageNo);
+  const unsigned char byte = reinterpret_cast<const unsigned char*>(fsmPage.page())[entry / 2];
+  return (entry % 2) ? byte >> FSM_BITS : byte & 0x0f;
+}
+
+void HeapFile::setLevel(const PageId pageNo, const std::uint32_t level)
+{
+  const PageId fsmPageNo = (pageNo - 1) / FSM_SPAN + 1;
+  while (fsmPages < fsmPageNo)
+  {
+    // new map pages start out saying every page is full
+    PageId newPageNo;
+    PageHandle newPage = bufMgr->allocPage(&fsmFile, newPageNo);
+    std::memset(reinterpret_cast<char*>(newPage.page()), 0, Page::SIZE);
+    newPage.markDirty();
+    fsmPages = newPageNo;
+  }
+
+  const PageId entry = (pageNo - 1) % FSM_SPAN;
+  PageHandle fsmPage = bufMgr->readPage(&fsmFile, fsmPageNo);
+  unsigned char& byte = reinterpret_cast<unsigned char*>(fsmPage.page())[entry / 2];
+  const unsigned char old = byte;
+  if (entry % 2)
+    byte = (byte & 0x0f) | (level << FSM_BITS);
+  else
+    byte = (byte & 0xf0) | level;
+  if (byte != old)
+    fsmPage.markDirty();
+
+  if (level > 0 && pageNo < searchStart)
+    searchStart = pageNo;
+}
+
+void HeapFile::useAppendPage(PageHandle&& handle, const PageId pageNo)
+{
+  appendPage = std::move(handle);
+  appendPageNo = pageNo;
+  appendLevel = getLevel(pageNo);
+}
+
+bool HeapFile::findPageWithRoom(const std::string& record)
+{
+  // the smallest level that guarantees room for the record and a new slot
+  const std::uint32_t needed = (record.size() + sizeof(PageSlot) + FSM_STEP - 1) / FSM_STEP;
+  if (needed >= (1u << FSM_BITS))
+    return false;
+
+  bool skippedNonEmpty = false;
+  for (PageId fsmPageNo = (searchStart - 1) / FSM_SPAN + 1; fsmPageNo <= fsmPages; fsmPageNo++)
+  {
+    const PageId first = (fsmPageNo - 1) * FSM_SPAN + 1;
+    PageId entry = (searchStart > first) ? searchStart - first : 0;
+    PageHandle fsmPage = bufMgr->readPage(&fsmFile, fsmPageNo);
+    const unsigned char* bytes = reinterpret_cast<const unsigned char*>(fsmPage.page());
+    for (; entry < FSM_SPAN; entry++)
+    {
+      const std::uint32_t level = (entry % 2) ? bytes[entry / 2] >> FSM_BITS : bytes[entry / 2] & 0x0f;
+      if (level == 0)
+      {
+        // nothing below the first page with some room is worth looking at again
+        if (!skippedNonEmpty)
+          searchStart = first + entry + 1;
+        continue;
+      }
+      const PageId pageNo = first + entry;
+      if (pageNo == appendPageNo || level < needed)
+      {
+        skippedNonEmpty = true;
+        continue;
+      }
+
+      fsmPage.release();
+      PageHandle candidate = bufMgr->readPage(&file, pageNo);
+      if (candidate->hasSpaceForRecord(record))
+      {
+        useAppendPage(std::move(candidate), pageNo);
+        return true;
+      }
+      // the map was out of date
+      setLevel(pageNo, levelFor(candidate->getFreeSpace()));
+      fsmPage = bufMgr->readPage(&fsmFile, fsmPageNo);
+      bytes = reinterpret_cast<const unsigned char*>(fsmPage.page());
+    }
+  }
+  return false;
+}
+
+RecordId HeapFile::insertRecord(const std::string& record)
+{
+  if (!appendPage.valid() || !appendPage->hasSpaceForRecord(record))
+  {
+    if (!findPageWithRoom(record))
+    {
+      PageId pageNo;
+      PageHandle newPage = bufMgr->allocPage(&file, pageNo, appendPageNo);
+      useAppendPage(std::move(newPage), pageNo);
+    }
+  }
+
+  // throws InsufficientSpaceException if the record does not fit even on an empty page
+  RecordId rid;
+  changePage(appendPage, appendPageNo, [&rid, &record](Page& page) { rid = page.insertRecord(record); });
+
+  // keep the map up to date as the page fills, but only touch it when the page's level changes
+  const std::uint32_t level = levelFor(appendPage->getFreeSpace());
+  if (level != appendLevel)
+  {
+    appendLevel = level;
+    setLevel(appendPageNo, level);
+  }
+  return rid;
+}
+
+std::string HeapFile::getRecord(const RecordId& rid)
+{
+  if (rid.page_number == appendPageNo)
+    return appendPage->getRecord(rid);
+  PageHandle page = bufMgr->readPage(&file, rid.page_number);
+  return page->getRecord(rid);
+}
+
+void HeapFile::deleteRecord(const RecordId& rid)
+{
+  if (rid.page_number == appendPageNo)
+  {
+    changePage(appendPage, appendPageNo, [&rid](Page& page) { page.deleteRecord(rid); });
+    appendLevel = levelFor(appendPage->getFreeSpace());
+    setLevel(appendPageNo, appendLevel);
+    return;
+  }
+  PageHandle page = bufMgr->readPage(&file, rid.page_number);
+  changePage(page, rid.page_number, [&rid](Page& changed) { changed.deleteRecord(rid); });
+  setLevel(rid.page_number, levelFor(page->getFreeSpace()));
+}
+
+void HeapFile::flush()
+{
+  appendPage.release();
+  appendPageNo = Page::INVALID_NUMBER;
+  bufMgr->flushFile(&file);
+  bufMgr->flushFile(&fsmFile);
+}
+
+void HeapFile::changePage(PageHandle& page, const PageId pageNo, const std::function<void(Page&)>& apply)
+{
+  LogManager* log = bufMgr->getLog();
+  if (log == NULL)
+  {
+    apply(*page);
+    page.markDirty();
+    return;
+  }
+  Page changed = *page;
+  apply(changed);
+  page.markDirty(log->updatePage(&file, pageNo, *page, changed));
+}
+
+void HeapFile::rebuildMap()
+{
+  for (FileIterator iter = file.begin(); iter != file.end(); ++iter)
+  {
+    PageHandle page = bufMgr->readPage(&file, iter.page_number());
+    const std::uint32_t level = levelFor(page->getFreeSpace());
+    page.release();
+    setLevel(iter.page_number(), level);
+  }
+}
+
+}
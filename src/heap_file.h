@@ -0,0 +1,210 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+
+#include "types.h"
+#include "page.h"
+#include "file.h"
+#include "buffer.h"
+#include "pool_registry.h"
+
+namespace badgerdb {
+
+/**
+ * @brief A relation stored as a PageFile of slotted pages, with a free-space map, read and written through a
+ *        buffer pool.
+ *
+ * insertRecord() places a record on the page it is currently filling, which stays pinned between inserts. When
+ * that page is full it looks in the free-space map for a page with room, such as one records were deleted from,
+ * and only allocates a new page if there is none.
+ *
+ * The free-space map keeps FSM_BITS bits per page: the page's free space in units of FSM_STEP bytes, rounded
+ * down. It lives in a BlobFile next to the relation, named after it with FSM_SUFFIX, whose pages each cover
+ * FSM_SPAN pages of the relation. The map is only a hint; a page it points to is checked before use, and the map
+ * is corrected if it was wrong. If the map file is missing when the relation is opened it is rebuilt from the
+ * pages.
+ *
+ * Pages changed through a HeapFile are in its buffer pool until flush() or the destructor writes them, so other
+ * File objects on the same relation, such as the one a FileScan opens, only see them after that.
+ *
+ * If the buffer manager has a write-ahead log attached, inserts and deletes are logged as physical updates to
+ * the relation's pages, so LogManager::redo() can bring the relation up to date after a crash. The free-space
+ * map is not logged; it is only a hint.
+ *
+ * @warning This class is not threadsafe.
+ */
+class HeapFile
+{
+ public:
+	/**
+   * Suffix added to the name of the relation to name its free-space map
+	 */
+  static const char* const FSM_SUFFIX;
+
+	/**
+   * Bits of the free-space map per page, and the bytes of free space one unit of the map stands for
+	 */
+  static const std::uint32_t FSM_BITS = 4;
+  static const std::uint32_t FSM_STEP = Page::SIZE >> FSM_BITS;
+
+	/**
+   * Number of relation pages each page of the free-space map covers
+	 */
+  static const PageId FSM_SPAN = Page::SIZE * 8 / FSM_BITS;
+
+	/**
+   * Opens or creates a relation.
+   *
+   * @param name        Name of the relation's file
+   * @param bufMgr      Buffer manager to read and write the relation and its free-space map through
+   * @param create_new  Whether to create a new relation
+   * @throws  FileExistsException     If create_new is true and the relation exists
+   * @throws  FileNotFoundException   If create_new is false and the relation does not exist
+   */
+  HeapFile(const std::string& name, BufMgr* bufMgr, const bool create_new);
+
+	/**
+   * Opens or creates a relation, using the buffer pool the registry assigns to it.
+   *
+   * @throws  PoolNotFoundException   If the relation's pool does not exist
+   */
+  HeapFile(const std::string& name, BufPoolRegistry* pools, const bool create_new);
+
+	/**
+   * Unpins the current page, writes out the relation and its free-space map and closes both. Pages of either
+   * file must not be pinned elsewhere by then: the buffer pool can not keep pages whose File object is gone, so
+   * if some can not be written or dropped the program is aborted, after writing out what it can.
+	 */
+  ~HeapFile();
+
+	/**
+   * Deletes a relation and its free-space map. Neither may be open.
+   *
+   * @param name  Name of the relation's file
+   * @throws  FileNotFoundException   If the relation does not exist
+   * @throws  FileOpenException       If the relation is open
+   */
+  static void remove(const std::string& name);
+
+	/**
+   * Inserts a record into the relation.
+   *
+   * @param record  Bytes of the record
+   * @return  ID of the new record
+   * @throws  InsufficientSpaceException  If the record does not fit on an empty page
+   */
+  RecordId insertRecord(const std::string& record);
+
+	/**
+   * Returns a copy of a record.
+   *
+   * @param rid   ID of the record
+   * @throws  InvalidRecordException  If there is no such record
+   */
+  std::string getRecord(const RecordId& rid);
+
+	/**
+   * Deletes a record. The space it took is reused by later inserts.
+   *
+   * @param rid   ID of the record
+   * @throws  InvalidRecordException  If there is no such record
+   */
+  void deleteRecord(const RecordId& rid);
+
+	/**
+   * Unpins the current page and writes out all changed pages of the relation and its free-space map.
+	 */
+  void flush();
+
+	/**
+   * Returns the relation's file. Pages read through it outside of the buffer pool may be out of date unless
+   * flush() has been called since the last change.
+	 */
+  PageFile* getFile() { return &file; }
+
+ private:
+  HeapFile(const HeapFile&);
+  HeapFile& operator=(const HeapFile&);
+
+	/**
+   * Free-space map level of a page with the given free space
+	 */
+  static std::uint32_t levelFor(const std::uint32_t freeSpace);
+
+	/**
+   * Returns the level a page has in the free-space map.
+	 */
+  std::uint32_t getLevel(const PageId pageNo);
+
+	/**
+   * Records a page's level in the free-space map, extending the map to cover the page if needed.
+	 */
+  void setLevel(const PageId pageNo, const std::uint32_t level);
+
+	/**
+   * Makes the given page the one inserts go to, pinning it. Unpins the previous one.
+	 */
+  void useAppendPage(PageHandle&& handle, const PageId pageNo);
+
+	/**
+   * Finds a page other than the current one with room for the record and makes it the current page.
+   *
+   * @return  False if no page in the free-space map has room
+	 */
+  bool findPageWithRoom(const std::string& record);
+
+	/**
+   * Fills in a new free-space map from the pages of the relation.
+	 */
+  void rebuildMap();
+
+	/**
+   * Applies a change to a pinned page of the relation and marks the page dirty. With a write-ahead log, the
+   * change is made to a copy and the difference is logged and applied.
+   *
+   * @param page    Pin on the page
+   * @param pageNo  Number of the page
+   * @param apply   Makes the change to the page it is given; if it throws, the page is left as it was
+	 */
+  void changePage(PageHandle& page, const PageId pageNo, const std::function<void(Page&)>& apply);
+
+	/**
+   * The relation and its free-space map
+	 */
+  PageFile file;
+  BlobFile fsmFile;
+
+	/**
+   * Buffer manager used for both files
+	 */
+  BufMgr* bufMgr;
+
+	/**
+   * Pin on the page inserts go to, its number and the level the free-space map has for it
+	 */
+  PageHandle appendPage;
+  PageId appendPageNo;
+  std::uint32_t appendLevel;
+
+	/**
+   * Number of pages in the free-space map file. They are allocated in order and never freed, so they are pages 1
+   * to fsmPages.
+	 */
+  PageId fsmPages;
+
+	/**
+   * No page numbered below this one has a non-zero level in the free-space map, so searches start here
+	 */
+  PageId searchStart;
+};
+
+}
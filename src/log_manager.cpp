@@ -0,0 +1,385 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include "log_manager.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "exceptions/invalid_page_exception.h"
+#include "exceptions/log_io_exception.h"
+
+namespace badgerdb {
+
+namespace {
+
+/**
+ * Start of the log file, in front of the records.
+ */
+struct LogFileHeader
+{
+  Lsn start;									/* LSN of the first byte of the first record */
+};
+
+/**
+ * Fixed part of a record on disk. It is followed by the file name, the before image and the after image.
+ */
+struct RecordHeader
+{
+  std::uint32_t size;					/* bytes in the whole record */
+  std::uint32_t checksum;			/* of everything after the header */
+  PageId pageNo;
+  std::uint16_t offset;
+  std::uint16_t length;				/* of each image */
+  std::uint16_t nameLength;
+};
+
+// FNV-1a, enough to tell a record cut off by a crash from a complete one
+std::uint32_t checksumOf(const char* data, const std::size_t size)
+{
+  std::uint32_t hash = 2166136261u;
+  for (std::size_t i = 0; i < size; i++)
+  {
+    hash ^= (unsigned char) data[i];
+    hash *= 16777619u;
+  }
+  return hash;
+}
+
+bool writeFully(const int fd, const char* data, const std::size_t size)
+{
+  std::size_t written = 0;
+  while (written < size)
+  {
+    const ssize_t n = ::write(fd, data + written, size - written);
+    if (n < 0)
+      return false;
+    written += n;
+  }
+  return true;
+}
+
+}
+
+LogManager::LogManager(const std::string& filename)
+	: filename(filename), appended(0), flushed(0), start(0), flushing(false), broken(false)
+{
+  fd = ::open(filename.c_str(), O_RDWR | O_CREAT | O_APPEND, 0644);
+  if (fd < 0)
+    throw LogIOException(filename);
+  off_t end = ::lseek(fd, 0, SEEK_END);
+  LogFileHeader fileHeader = {0};
+  if (end < (off_t) sizeof(LogFileHeader))
+  {
+    // a new log, or one whose header never made it to disk
+    if (::ftruncate(fd, 0) != 0 ||
+        !writeFully(fd, reinterpret_cast<const char*>(&fileHeader), sizeof(LogFileHeader)) ||
+        ::fdatasync(fd) != 0)
+    {
+      ::close(fd);
+      throw LogIOException(filename);
+    }
+    end = sizeof(LogFileHeader);
+  }
+  else if (::pread(fd, &fileHeader, sizeof(LogFileHeader), 0) != (ssize_t) sizeof(LogFileHeader))
+  {
+    ::close(fd);
+    throw LogIOException(filename);
+  }
+  start = fileHeader.start;
+  flushed = start + (end - sizeof(LogFileHeader));
+  appended = flushed;
+
+  // cut off a record torn by a crash, or records appended after it could never be read back
+  Lsn last = start;
+  scan([&last](const Lsn lsn, const LogRecord& record) { last = lsn; });
+  if (last < flushed)
+  {
+    if (::ftruncate(fd, offsetOf(last)) != 0)
+    {
+      ::close(fd);
+      throw LogIOException(filename);
+    }
+    appended = flushed = last;
+  }
+}
+
+LogManager::~LogManager()
+{
+  try
+  {
+    flush(endLsn());
+  }
+  catch (const LogIOException &e)
+  {
+    // destructors must not throw; the records are lost as in a crash
+  }
+  ::close(fd);
+}
+
+Lsn LogManager::update(const File* file, const PageId pageNo, Page& page, const std::uint16_t offset,
+                       const void* bytes, const std::uint16_t length)
+{
+  char* pageBytes = reinterpret_cast<char*>(&page);
+
+  RecordHeader header;
+  const std::string& name = file->filename();
+  header.size = sizeof(RecordHeader) + name.size() + 2 * length;
+  header.pageNo = pageNo;
+  header.offset = offset;
+  header.length = length;
+  header.nameLength = name.size();
+
+  std::string record(sizeof(RecordHeader), '\0');
+  record.append(name);
+  record.append(pageBytes + offset, length);
+  record.append(reinterpret_cast<const char*>(bytes), length);
+  header.checksum = checksumOf(record.data() + sizeof(RecordHeader), record.size() - sizeof(RecordHeader));
+  std::memcpy(&record[0], &header, sizeof(RecordHeader));
+
+  std::memcpy(pageBytes + offset, bytes, length);
+  return append(record);
+}
+
+Lsn LogManager::updatePage(const File* file, const PageId pageNo, Page& page, const Page& changed)
+{
+  const char* before = reinterpret_cast<const char*>(&page);
+  const char* after = reinterpret_cast<const char*>(&changed);
+  Lsn lsn = 0;
+  std::size_t i = 0;
+  while (i < Page::SIZE)
+  {
+    if (before[i] == after[i])
+    {
+      i++;
+      continue;
+    }
+    // take in unchanged bytes up to the size of a record header, which a record of their own would cost
+    std::size_t end = i + 1;
+    for (std::size_t j = end; j < Page::SIZE && j - end < sizeof(RecordHeader); j++)
+    {
+      if (before[j] != after[j])
+        end = j + 1;
+    }
+    lsn = update(file, pageNo, page, i, after + i, end - i);
+    i = end;
+  }
+  return lsn;
+}
+
+Lsn LogManager::append(const std::string& record)
+{
+  std::lock_guard<std::mutex> guard(mutex);
+  buffer.append(record);
+  appended += record.size();
+  return appended;
+}
+
+off_t LogManager::offsetOf(const Lsn lsn) const
+{
+  return sizeof(LogFileHeader) + (lsn - start);
+}
+
+void LogManager::flush(const Lsn lsn)
+{
+  std::unique_lock<std::mutex> lock(mutex);
+  while (flushed < lsn && flushed < appended)
+  {
+    if (broken)
+      throw LogIOException(filename);
+    if (flushing)
+    {
+      // our records may go out with the flush in progress
+      flushDone.wait(lock);
+      continue;
+    }
+
+    // write out everything appended so far, on behalf of every waiting thread
+    flushing = true;
+    std::string batch;
+    batch.swap(buffer);
+    const Lsn target = appended;
+    lock.unlock();
+
+    const bool ok = writeFully(fd, batch.data(), batch.size()) && ::fdatasync(fd) == 0;
+
+    lock.lock();
+    flushing = false;
+    if (ok)
+      flushed = target;
+    else
+    {
+      // put the batch back in front of the records appended since and cut off the part of it that reached the
+      // file, so offsets in the file keep matching LSNs and the next flush writes the batch again
+      buffer.insert(0, batch);
+      if (::ftruncate(fd, offsetOf(flushed)) != 0)
+        broken = true;
+    }
+    flushDone.notify_all();
+    if (!ok)
+      throw LogIOException(filename);
+  }
+}
+
+Lsn LogManager::flushedLsn()
+{
+  std::lock_guard<std::mutex> guard(mutex);
+  return flushed;
+}
+
+Lsn LogManager::endLsn() const
+{
+  return appended;
+}
+
+Lsn LogManager::startLsn()
+{
+  std::lock_guard<std::mutex> guard(mutex);
+  return start;
+}
+
+Lsn LogManager::truncationPoint(const Lsn lsn)
+{
+  Lsn begin;
+  Lsn end;
+  {
+    std::lock_guard<std::mutex> guard(mutex);
+    begin = start;
+    end = flushed;
+  }
+  const Lsn upTo = std::min(lsn, end);
+  if (upTo <= begin || upTo - begin < end - upTo)
+    return 0;
+
+  Lsn point = 0;
+  scan([&point, upTo](const Lsn recordLsn, const LogRecord& record) {
+    if (recordLsn <= upTo)
+      point = recordLsn;
+  });
+  return point;
+}
+
+void LogManager::truncate(const Lsn lsn)
+{
+  std::unique_lock<std::mutex> lock(mutex);
+  while (flushing)
+    flushDone.wait(lock);
+  if (broken)
+    throw LogIOException(filename);
+  if (lsn <= start || lsn > flushed)
+    return;
+
+  // keep flushes out while the file is replaced; they wait for flushing to clear
+  flushing = true;
+  const off_t from = offsetOf(lsn);
+  const off_t to = offsetOf(flushed);
+  lock.unlock();
+
+  // copy the records kept behind a new header, then put the copy in place of the log. Whichever of the two
+  // files a crash leaves behind, redo() finds every record it needs.
+  const std::string temp = filename + ".new";
+  const int newFd = ::open(temp.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_APPEND, 0644);
+  bool ok = newFd >= 0;
+  const LogFileHeader fileHeader = {lsn};
+  ok = ok && writeFully(newFd, reinterpret_cast<const char*>(&fileHeader), sizeof(LogFileHeader));
+  std::vector<char> chunk(1 << 16);
+  for (off_t pos = from; ok && pos < to; )
+  {
+    const ssize_t n = ::pread(fd, &chunk[0], std::min<off_t>(chunk.size(), to - pos), pos);
+    ok = n > 0 && writeFully(newFd, &chunk[0], n);
+    pos += n;
+  }
+  ok = ok && ::fdatasync(newFd) == 0 && std::rename(temp.c_str(), filename.c_str()) == 0;
+  if (!ok && newFd >= 0)
+  {
+    ::close(newFd);
+    std::remove(temp.c_str());
+  }
+
+  lock.lock();
+  flushing = false;
+  if (ok)
+  {
+    ::close(fd);
+    fd = newFd;
+    start = lsn;
+  }
+  flushDone.notify_all();
+  if (!ok)
+    throw LogIOException(filename);
+}
+
+void LogManager::scan(const std::function<void(const Lsn, const LogRecord&)>& visit)
+{
+  std::ifstream in(filename.c_str(), std::ios::binary);
+  const Lsn end = flushedLsn();
+  LogFileHeader fileHeader;
+  if (!in.read(reinterpret_cast<char*>(&fileHeader), sizeof(LogFileHeader)))
+    return;
+  Lsn pos = fileHeader.start;
+  std::string body;
+  RecordHeader header;
+  while (pos + sizeof(RecordHeader) <= end && in.read(reinterpret_cast<char*>(&header), sizeof(RecordHeader)))
+  {
+    if (header.size != sizeof(RecordHeader) + header.nameLength + 2 * header.length || pos + header.size > end)
+      break;
+    body.resize(header.size - sizeof(RecordHeader));
+    if (!in.read(&body[0], body.size()) || checksumOf(body.data(), body.size()) != header.checksum)
+      break;
+
+    LogRecord record;
+    record.filename.assign(body, 0, header.nameLength);
+    record.pageNo = header.pageNo;
+    record.offset = header.offset;
+    record.before.assign(body, header.nameLength, header.length);
+    record.after.assign(body, header.nameLength + header.length, header.length);
+    pos += header.size;
+    visit(pos, record);
+  }
+}
+
+std::uint32_t LogManager::redo(const std::vector<File*>& files)
+{
+  // the headers are written lazily, so after a crash they may not cover the pages the records are for
+  std::map<std::string, File*> byName;
+  for (std::size_t i = 0; i < files.size(); i++)
+  {
+    files[i]->recoverHeader();
+    byName[files[i]->filename()] = files[i];
+  }
+
+  std::uint32_t applied = 0;
+  scan([&byName, &applied](const Lsn lsn, const LogRecord& record) {
+    std::map<std::string, File*>::iterator file = byName.find(record.filename);
+    if (file == byName.end())
+      return;
+    Page page;
+    try
+    {
+      file->second->readPageInto(record.pageNo, page);
+    }
+    catch (const InvalidPageException &e)
+    {
+      // the page has been deleted since
+      return;
+    }
+    std::memcpy(reinterpret_cast<char*>(&page) + record.offset, record.after.data(), record.after.size());
+    file->second->writePage(record.pageNo, page);
+    applied++;
+  });
+
+  for (std::size_t i = 0; i < files.size(); i++)
+    files[i]->sync();
+  return applied;
+}
+
+}
@@ -0,0 +1,240 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <sys/types.h>
+
+#include "file.h"
+#include "page.h"
+#include "types.h"
+
+namespace badgerdb {
+
+/**
+ * @brief Log sequence number: the position in the log just past the end of a record, counted from the start of
+ * the first record ever written, so it keeps growing when the front of the log is cut off. 0 stands for no record.
+ */
+typedef std::uint64_t Lsn;
+
+/**
+ * @brief A page update read back from the log.
+ */
+struct LogRecord
+{
+	/**
+   * Name of the file the page belongs to
+	 */
+  std::string filename;
+
+  PageId pageNo;
+
+	/**
+   * Offset of the changed bytes in the page, counted over all Page::SIZE bytes of the page including its header
+	 */
+  std::uint16_t offset;
+
+	/**
+   * The changed bytes before (undo) and after (redo) the update; both have the same length
+	 */
+  std::string before;
+  std::string after;
+};
+
+/**
+ * @brief A write-ahead log of physical page updates, with group commit.
+ *
+ * A thread that changes a page logs the change with update(), which applies it to the page and returns the LSN
+ * of the record, and then hands the LSN to the buffer manager when it unpins the page. Records are appended to
+ * a memory buffer; nothing is written until someone calls flush() for an LSN. The buffer manager does so before
+ * writing a page, for the page's LSN, so the log always reaches the disk before the pages it describes. A thread
+ * that needs its own change to be durable calls flush() itself.
+ *
+ * flush() is a group commit: one caller writes out and syncs everything appended so far while later callers
+ * wait, and those whose records went out with it return without a sync of their own. With many threads logging
+ * at once most of them share a sync.
+ *
+ * On restart, redo() replays the after images of the log into the files. Each record carries absolute bytes, so
+ * replaying the whole log in order is safe whatever state the pages were left in.
+ *
+ * Records are only needed until the pages they describe are on disk. truncate() cuts them off the front of the
+ * log; the buffer manager the log is attached to does so after a checkpoint, up to the oldest change it still
+ * holds in memory. The file starts with the LSN of its first record, so LSNs stay the same across a truncation.
+ */
+class LogManager
+{
+ public:
+  /**
+   * Opens the log file, creating it if it does not exist. New records are appended to the existing ones, after
+   * cutting off a record left incomplete by a crash.
+   *
+   * @param filename  Name of the log file
+   * @throws  LogIOException  If the file can not be opened
+   */
+  LogManager(const std::string& filename);
+
+  /**
+   * Writes out the records appended so far and closes the log.
+   */
+  ~LogManager();
+
+  /**
+   * Logs a change to a page and applies it. The caller must hold a pin on the page and pass the returned LSN to
+   * the buffer manager when unpinning it dirty.
+   *
+   * @param file      File the page belongs to
+   * @param pageNo    Number of the page
+   * @param page      The page, whose bytes at offset are the before image
+   * @param offset    Offset of the change in the page, counted over all Page::SIZE bytes including the header
+   * @param bytes     New contents of the changed range
+   * @param length    Length of the changed range
+   * @return  LSN of the record
+   */
+  Lsn update(const File* file, const PageId pageNo, Page& page, const std::uint16_t offset,
+             const void* bytes, const std::uint16_t length);
+
+  /**
+   * Logs the difference between a page and a changed copy of it and applies it, with one update() per changed
+   * range. Ranges separated by a few unchanged bytes share a record.
+   *
+   * @param file      File the page belongs to
+   * @param pageNo    Number of the page
+   * @param page      The page, pinned by the caller
+   * @param changed   The page as it should be
+   * @return  LSN of the last record, 0 if the copy does not differ from the page
+   */
+  Lsn updatePage(const File* file, const PageId pageNo, Page& page, const Page& changed);
+
+  /**
+   * Makes the log durable at least up to the given LSN, writing and syncing the records appended so far unless
+   * a concurrent flush() already covers them.
+   *
+   * If the write or the sync fails, the records stay in the buffer and whatever part of them reached the file is
+   * cut off again, so a later flush retries them.
+   *
+   * @param lsn   LSN that must be on disk when the call returns
+   * @throws  LogIOException  If the log can not be written or synced
+   */
+  void flush(const Lsn lsn);
+
+  /**
+   * Returns the LSN up to which the log is on disk.
+   */
+  Lsn flushedLsn();
+
+  /**
+   * Returns the LSN of the last record appended. Does not wait for the log's mutex.
+   */
+  Lsn endLsn() const;
+
+  /**
+   * Returns the LSN the log starts at: records up to here have been cut off.
+   */
+  Lsn startLsn();
+
+  /**
+   * Returns the end of the last record on disk at or before the given LSN, if cutting the log there is worth
+   * it: the records cut off must take at least as much space as those kept, which truncate() has to copy.
+   *
+   * @param lsn   LSN up to which the records are no longer needed
+   * @return  LSN to pass to truncate(), 0 if the log is better left as it is
+   */
+  Lsn truncationPoint(const Lsn lsn);
+
+  /**
+   * Cuts off the records up to the given LSN. The records kept are copied into a new file that then replaces the
+   * log, so a crash leaves either the old log or the new one. The caller must make sure the pages the records
+   * describe are on disk and synced.
+   *
+   * @param lsn   End of a record on disk, as returned by truncationPoint()
+   * @throws  LogIOException  If the new log can not be written
+   */
+  void truncate(const Lsn lsn);
+
+  /**
+   * Reads back the records on disk, in log order. A record cut off by a crash ends the scan.
+   *
+   * @param visit   Called with the LSN and contents of every record
+   */
+  void scan(const std::function<void(const Lsn, const LogRecord&)>& visit);
+
+  /**
+   * Replays the after images of all records on disk into the given files and syncs them. Meant for restart,
+   * before the files are used through a buffer pool. The files' headers are first rebuilt with
+   * File::recoverHeader(), since the ones on disk may predate pages the records are for. Records of other files
+   * and of pages deleted since are skipped.
+   *
+   * @param files   Files to bring up to date
+   * @return  Number of records applied
+   */
+  std::uint32_t redo(const std::vector<File*>& files);
+
+ private:
+  /**
+   * Appends a record to the buffer and returns its LSN.
+   */
+  Lsn append(const std::string& record);
+
+  /**
+   * Returns the position in the file of the given LSN. Called under the mutex.
+   */
+  off_t offsetOf(const Lsn lsn) const;
+
+  /**
+   * Name of the log file
+   */
+  const std::string filename;
+
+  /**
+   * Descriptor of the log file, opened for appending
+   */
+  int fd;
+
+  /**
+   * Records appended but not handed to a flush yet
+   */
+  std::string buffer;
+
+  /**
+   * LSN of the end of the buffer, and of the part of the log known to be on disk. appended only changes under
+   * the mutex but is read without it.
+   */
+  std::atomic<Lsn> appended;
+  Lsn flushed;
+
+  /**
+   * LSN of the first byte of the first record in the file
+   */
+  Lsn start;
+
+  /**
+   * True while some thread is writing and syncing the log, or replacing the file in truncate()
+   */
+  bool flushing;
+
+  /**
+   * True once a failed flush could not be undone, so that the file may no longer match the LSNs; every later
+   * flush fails
+   */
+  bool broken;
+
+  std::mutex mutex;
+
+  /**
+   * Signalled when a flush finishes
+   */
+  std::condition_variable flushDone;
+};
+
+}
@@ -18,7 +18,6 @@
 #include "exceptions/bad_scanrange_exception.h"
 #include "exceptions/bad_opcodes_exception.h"
 #include "exceptions/scan_not_initialized_exception.h"
-#include "exceptions/end_of_file_exception.h"
 
 #define checkPassFail(a, b) 																				\
 {																																		\
@@ -123,23 +122,16 @@ int main(int argc, char **argv)
 	{
 		FileScan fscan(relationName, bufMgr);
 
-		try
+		RecordId scanRid;
+		while(fscan.tryScanNext(scanRid))
 		{
-			RecordId scanRid;
-			while(1)
-			{
-				fscan.scanNext(scanRid);
-				//Assuming RECORD.i is our key, lets extract the key, which we know is INTEGER and whose byte offset is also know inside the record. 
-				std::string recordStr = fscan.getRecord();
-				const char *record = recordStr.c_str();
-				int key = *((int *)(record + offsetof (RECORD, i)));
-				std::cout << "Extracted : " << key << std::endl;
-			}
-		}
-		catch(const EndOfFileException &e)
-		{
-			std::cout << "Read all records" << std::endl;
+			//Assuming RECORD.i is our key, lets extract the key, which we know is INTEGER and whose byte offset is also know inside the record. 
+			std::string recordStr = fscan.getRecord();
+			const char *record = recordStr.c_str();
+			int key = *((int *)(record + offsetof (RECORD, i)));
+			std::cout << "Extracted : " << key << std::endl;
 		}
+		std::cout << "Read all records" << std::endl;
 	}
 	// filescan goes out of scope here, so relation file gets closed.
 
@@ -465,7 +457,6 @@ void intTests()
 int intScan(BTreeIndex * index, int lowVal, Operator lowOp, int highVal, Operator highOp)
 {
   RecordId scanRid;
-	Page *curPage;
 
   std::cout << "Scan for ";
   if( lowOp == GT ) { std::cout << "("; } else { std::cout << "["; }
@@ -485,28 +476,20 @@ int intScan(BTreeIndex * index, int lowVal, Operator lowOp, int highVal, Operato
 		return 0;
 	}
 
-	while(1)
+	while(index->tryScanNext(scanRid))
 	{
-		try
-		{
-			index->scanNext(scanRid);
-			bufMgr->readPage(file1, scanRid.page_number, curPage);
-			RECORD myRec = *(reinterpret_cast<const RECORD*>(curPage->getRecord(scanRid).data()));
-			bufMgr->unPinPage(file1, scanRid.page_number, false);
+		PageHandle curPage = bufMgr->readPage(file1, scanRid.page_number);
+		RECORD myRec = *(reinterpret_cast<const RECORD*>(curPage->getRecord(scanRid).data()));
+		curPage.release();
 
-			if( numResults < 5 )
-			{
-				std::cout << "at:" << scanRid.page_number << "," << scanRid.slot_number;
-				std::cout << " -->:" << myRec.i << ":" << myRec.d << ":" << myRec.s << ":" <<std::endl;
-			}
-			else if( numResults == 5 )
-			{
-				std::cout << "..." << std::endl;
-			}
+		if( numResults < 5 )
+		{
+			std::cout << "at:" << scanRid.page_number << "," << scanRid.slot_number;
+			std::cout << " -->:" << myRec.i << ":" << myRec.d << ":" << myRec.s << ":" <<std::endl;
 		}
-		catch(const IndexScanCompletedException &e)
+		else if( numResults == 5 )
 		{
-			break;
+			std::cout << "..." << std::endl;
 		}
 
 		numResults++;
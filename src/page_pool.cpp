@@ -0,0 +1,69 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include "page_pool.h"
+
+#include <cstdlib>
+#include <new>
+#include <sys/mman.h>
+
+namespace badgerdb {
+
+PagePool::PagePool(const std::uint32_t numPages, const PoolAllocation mode)
+	: base(NULL), mappedBytes(0), huge(false)
+{
+  if (mode == HEAP_POOL)
+  {
+    // Page::SIZE is a multiple of the alignment, so aligning the first frame aligns them all
+    void* mem;
+    if (posix_memalign(&mem, FRAME_ALIGNMENT, (std::size_t) (numPages > 0 ? numPages : 1) * sizeof(Page)) != 0)
+      throw std::bad_alloc();
+    base = static_cast<Page*>(mem);
+    for (std::uint32_t i = 0; i < numPages; i++)
+      new (&base[i]) Page();
+    return;
+  }
+
+  // round up to whole huge pages, so the tail of the pool can use one too
+  std::size_t bytes = (std::size_t) numPages * sizeof(Page);
+  bytes = (bytes + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE;
+  if (bytes == 0)
+    bytes = HUGE_PAGE_SIZE;
+
+  void* mem = MAP_FAILED;
+#ifdef MAP_HUGETLB
+  mem = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+  huge = (mem != MAP_FAILED);
+#endif
+  if (mem == MAP_FAILED)
+  {
+    // no huge pages reserved: fall back to ordinary pages and let the kernel
+    // promote them to transparent huge pages
+    mem = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mem == MAP_FAILED)
+      throw std::bad_alloc();
+#ifdef MADV_HUGEPAGE
+    madvise(mem, bytes, MADV_HUGEPAGE);
+#endif
+  }
+
+  // anonymous memory is zero filled on first touch; Page has no destructor and is
+  // trivially copyable, so frames need no construction before a page is copied in
+  base = static_cast<Page*>(mem);
+  mappedBytes = bytes;
+}
+
+PagePool::~PagePool()
+{
+  // Page has no destructor, so the frames of a heap pool need no destruction either
+  if (mappedBytes == 0)
+    std::free(base);
+  else
+    munmap(base, mappedBytes);
+}
+
+}
@@ -0,0 +1,92 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "page.h"
+
+namespace badgerdb {
+
+/**
+ * @brief Ways the memory of a buffer pool can be obtained.
+ */
+enum PoolAllocation
+{
+	HEAP_POOL = 0,				/* aligned heap memory, every frame initialized up front */
+	HUGE_PAGE_POOL = 1		/* anonymous mapping backed by 2 MB pages where possible, frames initialized on first use */
+};
+
+/**
+ * @brief The memory holding the frames of a buffer pool.
+ *
+ * A HUGE_PAGE_POOL is mapped with MAP_HUGETLB if the system has huge pages reserved, and otherwise mapped
+ * normally and marked for transparent huge pages. Either way the mapping is page aligned, so every frame starts
+ * on a 4 KB boundary, and its memory is only touched when a page is first read or allocated into a frame,
+ * which makes construction independent of the pool size. Frames of such a pool hold zero bytes, not an
+ * initialized Page, until the buffer manager assigns a page to them.
+ *
+ * A HEAP_POOL is allocated aligned to FRAME_ALIGNMENT, so frames of either kind of pool can be read into and
+ * written from directly by files opened for direct I/O.
+ */
+class PagePool
+{
+ public:
+  /**
+   * Allocates room for numPages pages.
+   *
+   * @param numPages  Number of frames
+   * @param mode      How to allocate the memory
+   * @throws  std::bad_alloc  If the memory can not be obtained
+   */
+  PagePool(const std::uint32_t numPages, const PoolAllocation mode);
+
+  ~PagePool();
+
+  /**
+   * Returns the first frame of the pool.
+   */
+  Page* pages() const { return base; }
+
+  /**
+   * Returns true if the pool is backed by reserved (MAP_HUGETLB) huge pages.
+   */
+  bool hugePages() const { return huge; }
+
+  /**
+   * Alignment of every frame; at least File::DIRECT_IO_ALIGNMENT
+   */
+  static const std::size_t FRAME_ALIGNMENT = 4096;
+
+  /**
+   * Size of the huge pages the pool is rounded up to
+   */
+  static const std::size_t HUGE_PAGE_SIZE = 2 * 1024 * 1024;
+
+ private:
+  PagePool(const PagePool&);
+  PagePool& operator=(const PagePool&);
+
+  /**
+   * First frame of the pool
+   */
+  Page* base;
+
+  /**
+   * Length of the mapping, 0 for a heap allocated pool
+   */
+  std::size_t mappedBytes;
+
+  /**
+   * True if the mapping uses reserved huge pages
+   */
+  bool huge;
+};
+
+}
@@ -0,0 +1,113 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+namespace badgerdb {
+
+/**
+ * @brief A background thread that runs a function at a fixed interval until stopped.
+ *
+ * Used by the buffer manager for its maintenance threads. The interval can be changed while the thread runs,
+ * and stop() wakes the thread up instead of waiting for the current interval to run out.
+ */
+class PeriodicTask
+{
+ public:
+  PeriodicTask()
+    : stopping(false), interval(0)
+  {
+  }
+
+  /**
+   * Stops the thread if it is still running.
+   */
+  ~PeriodicTask()
+  {
+    stop();
+  }
+
+  /**
+   * Starts running body every intervalMs milliseconds. Does nothing if the task is already running.
+   *
+   * @param taskBody    Function to run
+   * @param intervalMs  Pause between two runs, in milliseconds
+   */
+  void start(const std::function<void()>& taskBody, const std::uint32_t intervalMs)
+  {
+    std::lock_guard<std::mutex> guard(mutex);
+    if (thread.joinable())
+      return;
+    body = taskBody;
+    interval = intervalMs;
+    stopping = false;
+    thread = std::thread(&PeriodicTask::run, this);
+  }
+
+  /**
+   * Changes the pause between two runs. Takes effect after the current pause.
+   *
+   * @param intervalMs  Pause between two runs, in milliseconds
+   */
+  void setInterval(const std::uint32_t intervalMs)
+  {
+    std::lock_guard<std::mutex> guard(mutex);
+    interval = intervalMs;
+  }
+
+  /**
+   * Stops the thread and waits for it to exit. A run that is in progress is finished first.
+   */
+  void stop()
+  {
+    {
+      std::lock_guard<std::mutex> guard(mutex);
+      if (!thread.joinable())
+        return;
+      stopping = true;
+    }
+    wakeup.notify_all();
+    thread.join();
+  }
+
+  /**
+   * Returns true if the thread is running.
+   */
+  bool running()
+  {
+    std::lock_guard<std::mutex> guard(mutex);
+    return thread.joinable();
+  }
+
+ private:
+  void run()
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (!stopping)
+    {
+      lock.unlock();
+      body();
+      lock.lock();
+      wakeup.wait_for(lock, std::chrono::milliseconds(interval), [this] { return stopping; });
+    }
+  }
+
+  std::thread thread;
+  std::mutex mutex;
+  std::condition_variable wakeup;
+  std::function<void()> body;
+  bool stopping;
+  std::uint32_t interval;
+};
+
+}
@@ -0,0 +1,82 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include "pool_registry.h"
+
+#include "exceptions/pool_exists_exception.h"
+#include "exceptions/pool_not_found_exception.h"
+
+namespace badgerdb {
+
+const std::string BufPoolRegistry::HEAP_POOL_NAME = "heap";
+const std::string BufPoolRegistry::INDEX_POOL_NAME = "index";
+
+BufPoolRegistry::BufPoolRegistry()
+{
+  rolePools[HEAP_FILE] = HEAP_POOL_NAME;
+  rolePools[INDEX_FILE] = INDEX_POOL_NAME;
+}
+
+BufPoolRegistry::~BufPoolRegistry()
+{
+  for (std::map<std::string, BufMgr*>::iterator it = pools.begin(); it != pools.end(); ++it)
+    delete it->second;
+}
+
+BufMgr* BufPoolRegistry::createPool(const std::string& name, const std::uint32_t numFrames,
+                                    const ReplacementPolicyType policyType, const PoolAllocation allocation)
+{
+  std::lock_guard<std::mutex> guard(mutex);
+  if (pools.find(name) != pools.end())
+    throw PoolExistsException(name);
+
+  BufMgr* bufMgr = new BufMgr(numFrames, policyType, allocation);
+  pools[name] = bufMgr;
+  return bufMgr;
+}
+
+BufMgr* BufPoolRegistry::pool(const std::string& name)
+{
+  std::lock_guard<std::mutex> guard(mutex);
+  return findPool(name);
+}
+
+void BufPoolRegistry::bind(const std::string& filename, const std::string& poolName)
+{
+  std::lock_guard<std::mutex> guard(mutex);
+  bindings[filename] = poolName;
+}
+
+void BufPoolRegistry::setRolePool(const FileRole role, const std::string& poolName)
+{
+  std::lock_guard<std::mutex> guard(mutex);
+  rolePools[role] = poolName;
+}
+
+BufMgr* BufPoolRegistry::poolFor(const std::string& filename, const FileRole role)
+{
+  std::lock_guard<std::mutex> guard(mutex);
+  std::map<std::string, std::string>::iterator binding = bindings.find(filename);
+  if (binding != bindings.end())
+    return findPool(binding->second);
+  return findPool(rolePools[role]);
+}
+
+BufMgr* BufPoolRegistry::poolFor(const File* file)
+{
+  return poolFor(file->filename(), file->role());
+}
+
+BufMgr* BufPoolRegistry::findPool(const std::string& name)
+{
+  std::map<std::string, BufMgr*>::iterator it = pools.find(name);
+  if (it == pools.end())
+    throw PoolNotFoundException(name);
+  return it->second;
+}
+
+}
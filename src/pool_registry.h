@@ -0,0 +1,118 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <map>
+#include <mutex>
+#include <string>
+
+#include "buffer.h"
+
+namespace badgerdb {
+
+/**
+ * @brief A set of named buffer pools, each a separate BufMgr with its own size and replacement policy, and the
+ * assignment of files to them.
+ *
+ * A file uses the pool it was bound to with bind(), and otherwise the pool of its role, "heap" and "index" unless
+ * changed with setRolePool(). Giving index files a pool of their own keeps large relation scans from evicting
+ * them. BTreeIndex and FileScan take a registry in place of a BufMgr and look their pools up themselves.
+ *
+ * Since the BufMgr hash tables are keyed by File object, a file must always be used through the same pool; bind
+ * files before opening them.
+ */
+class BufPoolRegistry
+{
+ public:
+  /**
+   * Default pool names for the two file roles
+   */
+  static const std::string HEAP_POOL_NAME;
+  static const std::string INDEX_POOL_NAME;
+
+  BufPoolRegistry();
+
+  /**
+   * Destroys all pools, writing out their dirty pages.
+   */
+  ~BufPoolRegistry();
+
+  /**
+   * Creates a pool.
+   *
+   * @param name        Name of the pool
+   * @param numFrames   Number of frames in the pool
+   * @param policyType  Replacement policy of the pool
+   * @param allocation  How the memory of the pool is allocated
+   * @return  The new pool, owned by the registry
+   * @throws  PoolExistsException If a pool of that name exists already
+   */
+  BufMgr* createPool(const std::string& name, const std::uint32_t numFrames,
+                     const ReplacementPolicyType policyType = CLOCK, const PoolAllocation allocation = HEAP_POOL);
+
+  /**
+   * Returns the pool of the given name.
+   *
+   * @param name  Name of the pool
+   * @throws  PoolNotFoundException If there is no such pool
+   */
+  BufMgr* pool(const std::string& name);
+
+  /**
+   * Makes the file use the given pool, whatever its role.
+   *
+   * @param filename  Name of the file
+   * @param poolName  Name of the pool; it need not exist yet
+   */
+  void bind(const std::string& filename, const std::string& poolName);
+
+  /**
+   * Changes the pool used by files of the given role that are not bound to a pool.
+   *
+   * @param role      File role
+   * @param poolName  Name of the pool; it need not exist yet
+   */
+  void setRolePool(const FileRole role, const std::string& poolName);
+
+  /**
+   * Returns the pool the file uses.
+   *
+   * @param filename  Name of the file
+   * @param role      What the file holds
+   * @throws  PoolNotFoundException If the pool the file is assigned to does not exist
+   */
+  BufMgr* poolFor(const std::string& filename, const FileRole role);
+
+  /**
+   * Returns the pool the file uses. BlobFiles have the index role, other files the heap role.
+   *
+   * @param file  File object
+   * @throws  PoolNotFoundException If the pool the file is assigned to does not exist
+   */
+  BufMgr* poolFor(const File* file);
+
+ private:
+  BufPoolRegistry(const BufPoolRegistry&);
+  BufPoolRegistry& operator=(const BufPoolRegistry&);
+
+  /**
+   * Returns the pool of the given name; the caller holds mutex.
+   */
+  BufMgr* findPool(const std::string& name);
+
+  std::map<std::string, BufMgr*> pools;
+  std::map<std::string, std::string> bindings;
+  std::map<FileRole, std::string> rolePools;
+
+  /**
+   * Protects the three maps
+   */
+  std::mutex mutex;
+};
+
+}
@@ -0,0 +1,431 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include "replacement_policy.h"
+
+namespace badgerdb {
+
+ReplacementPolicy* ReplacementPolicy::create(const ReplacementPolicyType type, const std::uint32_t numFrames)
+{
+  switch (type)
+  {
+    case TWO_Q:
+      return new TwoQPolicy(numFrames);
+    case LRU_K:
+      return new LRUKPolicy(numFrames);
+    case CLOCK:
+    default:
+      return new ClockPolicy(numFrames);
+  }
+}
+
+//----------------------------------------
+// Clock
+//----------------------------------------
+
+ClockPolicy::ClockPolicy(const std::uint32_t numFrames)
+	: numFrames(numFrames), clockHand(numFrames - 1), refbits(new std::atomic<bool>[numFrames])
+{
+  for (FrameId i = 0; i < numFrames; i++)
+    refbits[i] = false;
+}
+
+void ClockPolicy::pageLoaded(const FrameId frame, const File* file, const PageId pageNo)
+{
+  refbits[frame] = true;
+}
+
+void ClockPolicy::pageAccessed(const FrameId frame)
+{
+  refbits[frame] = true;
+}
+
+void ClockPolicy::frameFreed(const FrameId frame)
+{
+  refbits[frame] = false;
+}
+
+bool ClockPolicy::selectVictim(const EvictionCheck& canEvict, FrameId& frame)
+{
+  std::uint32_t numScanned = 0;
+
+  while (numScanned < 2*numFrames)	//Need to scan twice
+  {
+    // advance the clock
+    FrameId candidate = (clockHand.fetch_add(1) + 1) % numFrames;
+    numScanned++;
+
+    // has been referenced, clear the bit and give it another round
+    if (refbits[candidate].exchange(false))
+      continue;
+
+    if (canEvict(candidate))
+    {
+      frame = candidate;
+      return true;
+    }
+  }
+
+  return false;
+}
+
+void ClockPolicy::victimKept(const FrameId frame)
+{
+  // the hand has passed the frame with its bit clear, which is where it would be anyway
+}
+
+void ClockPolicy::nextVictims(std::vector<FrameId>& frames, const std::uint32_t count)
+{
+  // the frames just ahead of the hand
+  FrameId hand = clockHand.load();
+  for (std::uint32_t i = 1; i <= count && i <= numFrames; i++)
+    frames.push_back((hand + i) % numFrames);
+}
+
+void ClockPolicy::resize(const std::uint32_t newNumFrames)
+{
+  std::unique_ptr<std::atomic<bool>[]> newRefbits(new std::atomic<bool>[newNumFrames]);
+  for (FrameId i = 0; i < newNumFrames; i++)
+    newRefbits[i] = (i < numFrames) ? refbits[i].load() : false;
+  refbits.swap(newRefbits);
+  numFrames = newNumFrames;
+  clockHand = clockHand.load() % numFrames;
+}
+
+//----------------------------------------
+// 2Q
+//----------------------------------------
+
+TwoQPolicy::TwoQPolicy(const std::uint32_t numFrames)
+	: kIn(numFrames / 4 > 0 ? numFrames / 4 : 1), kOut(numFrames / 2 > 0 ? numFrames / 2 : 1),
+	  queueOf(numFrames, FREE), position(numFrames), pageOf(numFrames, PageKey(NULL, PageId(Page::INVALID_NUMBER))),
+	  selectedFrom(numFrames, FREE)
+{
+  for (FrameId i = 0; i < numFrames; i++)
+    position[i] = freeFrames.insert(freeFrames.end(), i);
+}
+
+void TwoQPolicy::unlink(const FrameId frame)
+{
+  switch (queueOf[frame])
+  {
+    case NONE: break;
+    case FREE: freeFrames.erase(position[frame]); break;
+    case A1IN: a1in.erase(position[frame]); break;
+    case AM: am.erase(position[frame]); break;
+  }
+}
+
+void TwoQPolicy::remember(const PageKey& key)
+{
+  if (a1outIndex.count(key))
+    return;
+  if (a1out.size() >= kOut)
+  {
+    a1outIndex.erase(a1out.front());
+    a1out.pop_front();
+  }
+  a1outIndex[key] = a1out.insert(a1out.end(), key);
+}
+
+void TwoQPolicy::pageLoaded(const FrameId frame, const File* file, const PageId pageNo)
+{
+  std::lock_guard<std::mutex> guard(mutex);
+  unlink(frame);
+
+  PageKey key(file, pageNo);
+  pageOf[frame] = key;
+
+  std::map<PageKey, std::list<PageKey>::iterator>::iterator ghost = a1outIndex.find(key);
+  if (ghost != a1outIndex.end())
+  {
+    // referenced again after falling out of probation: admit to the main queue
+    a1out.erase(ghost->second);
+    a1outIndex.erase(ghost);
+    queueOf[frame] = AM;
+    position[frame] = am.insert(am.end(), frame);
+  }
+  else
+  {
+    queueOf[frame] = A1IN;
+    position[frame] = a1in.insert(a1in.end(), frame);
+  }
+}
+
+void TwoQPolicy::pageAccessed(const FrameId frame)
+{
+  std::lock_guard<std::mutex> guard(mutex);
+
+  // hits on A1in are deliberately ignored; hits on Am move the page to the MRU end
+  if (queueOf[frame] == AM)
+    am.splice(am.end(), am, position[frame]);
+}
+
+void TwoQPolicy::frameFreed(const FrameId frame)
+{
+  std::lock_guard<std::mutex> guard(mutex);
+  unlink(frame);
+  queueOf[frame] = FREE;
+  position[frame] = freeFrames.insert(freeFrames.end(), frame);
+}
+
+bool TwoQPolicy::selectFrom(std::list<FrameId>& q, const EvictionCheck& canEvict, FrameId& frame)
+{
+  for (std::list<FrameId>::iterator it = q.begin(); it != q.end(); ++it)
+  {
+    if (canEvict(*it))
+    {
+      frame = *it;
+      selectedFrom[frame] = queueOf[frame];
+      if (queueOf[frame] == A1IN)
+        remember(pageOf[frame]);
+      q.erase(it);
+      // the caller installs a new page right away, so the frame goes on no list until pageLoaded()
+      queueOf[frame] = NONE;
+      return true;
+    }
+  }
+  return false;
+}
+
+bool TwoQPolicy::selectVictim(const EvictionCheck& canEvict, FrameId& frame)
+{
+  std::lock_guard<std::mutex> guard(mutex);
+
+  if (selectFrom(freeFrames, canEvict, frame))
+    return true;
+
+  if (a1in.size() > kIn || am.empty())
+    return selectFrom(a1in, canEvict, frame) || selectFrom(am, canEvict, frame);
+  return selectFrom(am, canEvict, frame) || selectFrom(a1in, canEvict, frame);
+}
+
+void TwoQPolicy::victimKept(const FrameId frame)
+{
+  std::lock_guard<std::mutex> guard(mutex);
+
+  // the frame was the oldest one on its queue that could be taken, so it goes back to the front
+  switch (selectedFrom[frame])
+  {
+    case A1IN:
+    {
+      // it is still in probation, not evicted from it
+      std::map<PageKey, std::list<PageKey>::iterator>::iterator ghost = a1outIndex.find(pageOf[frame]);
+      if (ghost != a1outIndex.end())
+      {
+        a1out.erase(ghost->second);
+        a1outIndex.erase(ghost);
+      }
+      queueOf[frame] = A1IN;
+      position[frame] = a1in.insert(a1in.begin(), frame);
+      break;
+    }
+    case AM:
+      queueOf[frame] = AM;
+      position[frame] = am.insert(am.begin(), frame);
+      break;
+    default:
+      queueOf[frame] = FREE;
+      position[frame] = freeFrames.insert(freeFrames.begin(), frame);
+      break;
+  }
+}
+
+void TwoQPolicy::nextVictims(std::vector<FrameId>& frames, const std::uint32_t count)
+{
+  std::lock_guard<std::mutex> guard(mutex);
+
+  std::list<FrameId>& first = (a1in.size() > kIn || am.empty()) ? a1in : am;
+  std::list<FrameId>& second = (&first == &a1in) ? am : a1in;
+  std::uint32_t listed = 0;
+  for (std::list<FrameId>::iterator it = first.begin(); it != first.end() && listed < count; ++it, ++listed)
+    frames.push_back(*it);
+  for (std::list<FrameId>::iterator it = second.begin(); it != second.end() && listed < count; ++it, ++listed)
+    frames.push_back(*it);
+}
+
+void TwoQPolicy::resize(const std::uint32_t numFrames)
+{
+  std::lock_guard<std::mutex> guard(mutex);
+
+  const std::uint32_t oldNumFrames = queueOf.size();
+  for (FrameId i = numFrames; i < oldNumFrames; i++)
+    unlink(i);
+  queueOf.resize(numFrames, FREE);
+  position.resize(numFrames);
+  pageOf.resize(numFrames, PageKey(NULL, PageId(Page::INVALID_NUMBER)));
+  selectedFrom.resize(numFrames, FREE);
+  for (FrameId i = oldNumFrames; i < numFrames; i++)
+    position[i] = freeFrames.insert(freeFrames.end(), i);
+
+  kIn = numFrames / 4 > 0 ? numFrames / 4 : 1;
+  kOut = numFrames / 2 > 0 ? numFrames / 2 : 1;
+  while (a1out.size() > kOut)
+  {
+    a1outIndex.erase(a1out.front());
+    a1out.pop_front();
+  }
+}
+
+//----------------------------------------
+// LRU-K
+//----------------------------------------
+
+LRUKPolicy::LRUKPolicy(const std::uint32_t numFrames)
+	: numFrames(numFrames), now(0), resident(numFrames, false), history(numFrames),
+	  pageOf(numFrames, PageKey(NULL, PageId(Page::INVALID_NUMBER)))
+{
+  for (FrameId i = 0; i < numFrames; i++)
+  {
+    history[i].last = history[i].previous = 0;
+    emptyFrames.insert(i);
+  }
+}
+
+LRUKPolicy::RankKey LRUKPolicy::rankOf(const FrameId frame) const
+{
+  return RankKey(std::make_pair(history[frame].previous, history[frame].last), frame);
+}
+
+void LRUKPolicy::pageLoaded(const FrameId frame, const File* file, const PageId pageNo)
+{
+  std::lock_guard<std::mutex> guard(mutex);
+  if (resident[frame])
+    ranking.erase(rankOf(frame));
+  emptyFrames.erase(frame);
+
+  PageKey key(file, pageNo);
+  pageOf[frame] = key;
+  history[frame].last = history[frame].previous = 0;
+
+  // pick up the history the page had when it was last evicted
+  std::map<PageKey, std::pair<History, std::list<PageKey>::iterator> >::iterator old = retained.find(key);
+  if (old != retained.end())
+  {
+    history[frame] = old->second.first;
+    retainedOrder.erase(old->second.second);
+    retained.erase(old);
+  }
+
+  history[frame].previous = history[frame].last;
+  history[frame].last = ++now;
+  resident[frame] = true;
+  ranking.insert(rankOf(frame));
+}
+
+void LRUKPolicy::pageAccessed(const FrameId frame)
+{
+  std::lock_guard<std::mutex> guard(mutex);
+  if (!resident[frame])
+    return;
+
+  ranking.erase(rankOf(frame));
+  history[frame].previous = history[frame].last;
+  history[frame].last = ++now;
+  ranking.insert(rankOf(frame));
+}
+
+void LRUKPolicy::frameFreed(const FrameId frame)
+{
+  std::lock_guard<std::mutex> guard(mutex);
+  if (resident[frame])
+    ranking.erase(rankOf(frame));
+  resident[frame] = false;
+  emptyFrames.insert(frame);
+}
+
+bool LRUKPolicy::selectVictim(const EvictionCheck& canEvict, FrameId& frame)
+{
+  std::lock_guard<std::mutex> guard(mutex);
+
+  // empty frames first
+  for (std::set<FrameId>::iterator it = emptyFrames.begin(); it != emptyFrames.end(); ++it)
+  {
+    if (canEvict(*it))
+    {
+      frame = *it;
+      emptyFrames.erase(it);
+      return true;
+    }
+  }
+
+  for (std::set<RankKey>::iterator it = ranking.begin(); it != ranking.end(); ++it)
+  {
+    if (canEvict(it->second))
+    {
+      frame = it->second;
+      ranking.erase(it);
+      resident[frame] = false;
+
+      // retain the history of the evicted page, forgetting the oldest retained one if needed
+      if (retained.size() >= numFrames)
+      {
+        retained.erase(retainedOrder.front());
+        retainedOrder.pop_front();
+      }
+      std::list<PageKey>::iterator pos = retainedOrder.insert(retainedOrder.end(), pageOf[frame]);
+      retained[pageOf[frame]] = std::make_pair(history[frame], pos);
+      return true;
+    }
+  }
+
+  return false;
+}
+
+void LRUKPolicy::victimKept(const FrameId frame)
+{
+  std::lock_guard<std::mutex> guard(mutex);
+
+  // take back the history selectVictim() retained for the page; it was never changed
+  std::map<PageKey, std::pair<History, std::list<PageKey>::iterator> >::iterator old = retained.find(pageOf[frame]);
+  if (old == retained.end())
+  {
+    emptyFrames.insert(frame);
+    return;
+  }
+  retainedOrder.erase(old->second.second);
+  retained.erase(old);
+  resident[frame] = true;
+  ranking.insert(rankOf(frame));
+}
+
+void LRUKPolicy::nextVictims(std::vector<FrameId>& frames, const std::uint32_t count)
+{
+  std::lock_guard<std::mutex> guard(mutex);
+
+  std::uint32_t listed = 0;
+  for (std::set<RankKey>::iterator it = ranking.begin(); it != ranking.end() && listed < count; ++it, ++listed)
+    frames.push_back(it->second);
+}
+
+void LRUKPolicy::resize(const std::uint32_t newNumFrames)
+{
+  std::lock_guard<std::mutex> guard(mutex);
+
+  for (FrameId i = newNumFrames; i < numFrames; i++)
+  {
+    if (resident[i])
+      ranking.erase(rankOf(i));
+    emptyFrames.erase(i);
+  }
+
+  History none = {0, 0};
+  resident.resize(newNumFrames, false);
+  history.resize(newNumFrames, none);
+  pageOf.resize(newNumFrames, PageKey(NULL, PageId(Page::INVALID_NUMBER)));
+  for (FrameId i = numFrames; i < newNumFrames; i++)
+    emptyFrames.insert(i);
+  numFrames = newNumFrames;
+
+  while (retained.size() > numFrames)
+  {
+    retained.erase(retainedOrder.front());
+    retainedOrder.pop_front();
+  }
+}
+
+}
@@ -0,0 +1,304 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <utility>
+#include <vector>
+
+#include "file.h"
+#include "types.h"
+
+namespace badgerdb {
+
+/**
+ * @brief Replacement policies the buffer manager can be constructed with.
+ */
+enum ReplacementPolicyType
+{
+	CLOCK = 0,	/* Single reference bit clock */
+	TWO_Q = 1,	/* 2Q: FIFO probation queue, LRU main queue and a ghost queue of evicted pages */
+	LRU_K = 2		/* LRU-2: evict the page whose second most recent access is oldest */
+};
+
+/**
+ * @brief Interface between BufMgr and the algorithm that picks victim frames.
+ *
+ * The buffer manager reports every page it installs in a frame, every buffer hit and every frame it empties
+ * outside of victim selection (flushFile(), disposePage(), failed reads). When it needs a frame it calls
+ * selectVictim(), which proposes candidates in preference order until the buffer manager accepts one.
+ * All hooks are called with the latch of the frame concerned held, and may be called from several threads.
+ */
+class ReplacementPolicy
+{
+ public:
+  /**
+   * Callback used by selectVictim() to offer a frame to the buffer manager. Returns true, with the frame
+   * latched, if the frame is empty or unpinned and may be reused.
+   */
+  typedef std::function<bool(FrameId)> EvictionCheck;
+
+  /**
+   * Creates a policy of the given type for a pool of numFrames frames.
+   *
+   * @param type        Policy to create
+   * @param numFrames   Number of frames in the buffer pool
+   * @return  Newly allocated policy, owned by the caller
+   */
+  static ReplacementPolicy* create(const ReplacementPolicyType type, const std::uint32_t numFrames);
+
+  virtual ~ReplacementPolicy() {}
+
+  /**
+   * Returns a short name of the policy, for reporting.
+   */
+  virtual const char* name() const = 0;
+
+  /**
+   * Called when a page has been read or allocated into a frame.
+   *
+   * @param frame   Frame the page now occupies
+   * @param file    File the page belongs to
+   * @param pageNo  Page number within the file
+   */
+  virtual void pageLoaded(const FrameId frame, const File* file, const PageId pageNo) = 0;
+
+  /**
+   * Called on every buffer hit.
+   *
+   * @param frame   Frame that was accessed
+   */
+  virtual void pageAccessed(const FrameId frame) = 0;
+
+  /**
+   * Called when a frame is emptied other than by being chosen as a victim.
+   *
+   * @param frame   Frame that is now empty
+   */
+  virtual void frameFreed(const FrameId frame) = 0;
+
+  /**
+   * Picks a frame to reuse. Candidates are offered to canEvict in the order the policy prefers them;
+   * the first one accepted is removed from the policy's bookkeeping and returned.
+   *
+   * @param canEvict  Callback deciding whether a candidate frame can be reused
+   * @param frame     Chosen frame returned via this variable
+   * @return  False if no frame was accepted
+   */
+  virtual bool selectVictim(const EvictionCheck& canEvict, FrameId& frame) = 0;
+
+  /**
+   * Called when a frame selectVictim() returned keeps the page it holds after all, because the page could not
+   * be written back. The frame goes back where selectVictim() took it from, and the page's reference history
+   * is left as it was before the selection; it does not count as a new reference.
+   *
+   * @param frame   Frame that was selected and still holds its page
+   */
+  virtual void victimKept(const FrameId frame) = 0;
+
+  /**
+   * Lists the occupied frames selectVictim() would consider next, most likely victim first, without changing
+   * any state. Used by the background writer to clean frames before they are needed.
+   *
+   * @param frames    Vector the frames are appended to
+   * @param count     Maximum number of frames to list
+   */
+  virtual void nextVictims(std::vector<FrameId>& frames, const std::uint32_t count) = 0;
+
+  /**
+   * Called when the buffer pool changes size, while no other hook can run. Before a shrink the frames being
+   * removed have all been reported freed; frames added by growing are empty.
+   *
+   * @param numFrames   New number of frames in the buffer pool
+   */
+  virtual void resize(const std::uint32_t numFrames) = 0;
+};
+
+/**
+ * @brief The clock algorithm with one reference bit per frame.
+ *
+ * Reference bits are atomic and the hand is advanced with an atomic increment, so buffer hits never take a lock.
+ */
+class ClockPolicy : public ReplacementPolicy
+{
+ public:
+  ClockPolicy(const std::uint32_t numFrames);
+
+  const char* name() const override { return "clock"; }
+  void pageLoaded(const FrameId frame, const File* file, const PageId pageNo) override;
+  void pageAccessed(const FrameId frame) override;
+  void frameFreed(const FrameId frame) override;
+  bool selectVictim(const EvictionCheck& canEvict, FrameId& frame) override;
+  void victimKept(const FrameId frame) override;
+  void nextVictims(std::vector<FrameId>& frames, const std::uint32_t count) override;
+  void resize(const std::uint32_t numFrames) override;
+
+ private:
+  /**
+   * Number of frames in the buffer pool
+   */
+  std::uint32_t numFrames;
+
+  /**
+   * Current position of the clock hand. Only ever incremented; reduced modulo numFrames on use.
+   */
+  std::atomic<FrameId> clockHand;
+
+  /**
+   * Has the frame been referenced since the hand last passed it
+   */
+  std::unique_ptr<std::atomic<bool>[]> refbits;
+};
+
+/**
+ * @brief The 2Q algorithm (Johnson and Shasha).
+ *
+ * Pages enter a FIFO probation queue (A1in). If they are evicted from it they are remembered in a ghost queue
+ * (A1out), and only a page that is referenced again while remembered there is admitted to the LRU main
+ * queue (Am). A single sequential scan therefore only cycles through A1in and never displaces the main queue.
+ */
+class TwoQPolicy : public ReplacementPolicy
+{
+ public:
+  TwoQPolicy(const std::uint32_t numFrames);
+
+  const char* name() const override { return "2q"; }
+  void pageLoaded(const FrameId frame, const File* file, const PageId pageNo) override;
+  void pageAccessed(const FrameId frame) override;
+  void frameFreed(const FrameId frame) override;
+  bool selectVictim(const EvictionCheck& canEvict, FrameId& frame) override;
+  void victimKept(const FrameId frame) override;
+  void nextVictims(std::vector<FrameId>& frames, const std::uint32_t count) override;
+  void resize(const std::uint32_t numFrames) override;
+
+ private:
+  typedef std::pair<const File*, PageId> PageKey;
+
+  /**
+   * Which queue a frame is currently on. NONE is a frame handed out by selectVictim() whose new page
+   * has not been reported yet.
+   */
+  enum Queue { NONE, FREE, A1IN, AM };
+
+  /**
+   * Removes the frame from whichever queue it is on.
+   */
+  void unlink(const FrameId frame);
+
+  /**
+   * Remembers an evicted probation page in A1out, forgetting the oldest one if A1out is full.
+   */
+  void remember(const PageKey& key);
+
+  /**
+   * Offers the frames of queue q, oldest first, to canEvict.
+   */
+  bool selectFrom(std::list<FrameId>& q, const EvictionCheck& canEvict, FrameId& frame);
+
+  /**
+   * Maximum number of frames on A1in before victims are taken from it
+   */
+  std::uint32_t kIn;
+
+  /**
+   * Maximum number of page identities remembered in A1out
+   */
+  std::uint32_t kOut;
+
+  std::list<FrameId> freeFrames;
+  std::list<FrameId> a1in;
+  std::list<FrameId> am;
+  std::list<PageKey> a1out;
+  std::map<PageKey, std::list<PageKey>::iterator> a1outIndex;
+
+  /**
+   * Queue membership, position and page identity of every frame
+   */
+  std::vector<Queue> queueOf;
+  std::vector<std::list<FrameId>::iterator> position;
+  std::vector<PageKey> pageOf;
+
+  /**
+   * Queue a frame was on when selectVictim() last handed it out
+   */
+  std::vector<Queue> selectedFrom;
+
+  std::mutex mutex;
+};
+
+/**
+ * @brief The LRU-K algorithm (O'Neil, O'Neil and Weikum) with K = 2.
+ *
+ * The victim is the page whose second most recent reference is the oldest. Pages referenced only once have an
+ * infinite backward distance and go first, oldest first, so one-off scan pages are evicted before pages that
+ * have proven to be reused. Reference history of evicted pages is retained for a bounded number of pages.
+ */
+class LRUKPolicy : public ReplacementPolicy
+{
+ public:
+  LRUKPolicy(const std::uint32_t numFrames);
+
+  const char* name() const override { return "lru-2"; }
+  void pageLoaded(const FrameId frame, const File* file, const PageId pageNo) override;
+  void pageAccessed(const FrameId frame) override;
+  void frameFreed(const FrameId frame) override;
+  bool selectVictim(const EvictionCheck& canEvict, FrameId& frame) override;
+  void victimKept(const FrameId frame) override;
+  void nextVictims(std::vector<FrameId>& frames, const std::uint32_t count) override;
+  void resize(const std::uint32_t numFrames) override;
+
+ private:
+  typedef std::pair<const File*, PageId> PageKey;
+
+  /**
+   * Times of the last two references; 0 means no such reference
+   */
+  struct History {
+    std::uint64_t last;
+    std::uint64_t previous;
+  };
+
+  /**
+   * Ordering key of a resident frame: (second last reference, last reference, frame)
+   */
+  typedef std::pair<std::pair<std::uint64_t, std::uint64_t>, FrameId> RankKey;
+
+  RankKey rankOf(const FrameId frame) const;
+
+  /**
+   * Number of frames in the buffer pool, also the number of evicted histories retained
+   */
+  std::uint32_t numFrames;
+
+  /**
+   * Logical time, advanced on every reference
+   */
+  std::uint64_t now;
+
+  std::vector<bool> resident;
+  std::set<FrameId> emptyFrames;
+  std::vector<History> history;
+  std::vector<PageKey> pageOf;
+  std::set<RankKey> ranking;
+
+  /**
+   * Histories of recently evicted pages, oldest first
+   */
+  std::list<PageKey> retainedOrder;
+  std::map<PageKey, std::pair<History, std::list<PageKey>::iterator> > retained;
+
+  std::mutex mutex;
+};
+
+}
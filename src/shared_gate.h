@@ -0,0 +1,140 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+namespace badgerdb {
+
+/**
+ * @brief A reader-writer lock for operations that are frequent and concurrent on one side and rare on the other.
+ *
+ * Any number of threads may be inside the gate at once. close() waits for all of them to leave and keeps new
+ * ones out until open() is called. Threads count themselves in one of several padded counters chosen by thread
+ * id, so entering and leaving the gate does not make every thread write the same cache line. The price is paid
+ * by close(), which polls the counters until they drain.
+ */
+class SharedGate
+{
+ public:
+  SharedGate()
+    : closed(false)
+  {
+    for (int i = 0; i < SLOTS; i++)
+      slots[i].count = 0;
+  }
+
+  /**
+   * Enters the gate, waiting while it is closed.
+   */
+  void enter()
+  {
+    std::atomic<int>& count = slots[slotOf()].count;
+    while (true)
+    {
+      count.fetch_add(1);
+      if (!closed.load())
+        return;
+
+      // closing: step back out and wait for the gate to open again
+      count.fetch_sub(1);
+      std::unique_lock<std::mutex> lock(mutex);
+      reopened.wait(lock, [this] { return !closed.load(); });
+    }
+  }
+
+  /**
+   * Leaves the gate. Must be called by the thread that entered it.
+   */
+  void leave()
+  {
+    slots[slotOf()].count.fetch_sub(1);
+  }
+
+  /**
+   * Closes the gate and waits until every thread inside has left. Must not be called from inside the gate.
+   * Only one thread can have the gate closed at a time.
+   */
+  void close()
+  {
+    closer.lock();
+    closed.store(true);
+    for (int i = 0; i < SLOTS; i++)
+    {
+      while (slots[i].count.load() != 0)
+        std::this_thread::sleep_for(std::chrono::microseconds(100));
+    }
+  }
+
+  /**
+   * Opens the gate again after close().
+   */
+  void open()
+  {
+    {
+      std::lock_guard<std::mutex> guard(mutex);
+      closed.store(false);
+    }
+    reopened.notify_all();
+    closer.unlock();
+  }
+
+  /**
+   * @brief Holds the gate open for the lifetime of the object.
+   */
+  class Guard
+  {
+   public:
+    Guard(SharedGate& gate)
+      : gate(gate)
+    {
+      gate.enter();
+    }
+
+    ~Guard()
+    {
+      gate.leave();
+    }
+
+   private:
+    SharedGate& gate;
+  };
+
+ private:
+  static const int SLOTS = 16;
+
+  /**
+   * A thread counter on a cache line of its own
+   */
+  struct Slot {
+    std::atomic<int> count;
+    char padding[64 - sizeof(std::atomic<int>)];
+  };
+
+  static int slotOf()
+  {
+    return std::hash<std::thread::id>()(std::this_thread::get_id()) % SLOTS;
+  }
+
+  Slot slots[SLOTS];
+  std::atomic<bool> closed;
+  std::mutex mutex;
+  std::condition_variable reopened;
+
+  /**
+   * Held from close() to open(), serializing the threads that close the gate
+   */
+  std::mutex closer;
+};
+
+}
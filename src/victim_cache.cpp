@@ -0,0 +1,260 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include "victim_cache.h"
+
+#include <cstring>
+
+namespace badgerdb {
+
+namespace {
+
+// The compressed format is a series of sequences, each a token byte, the
+// literal bytes and, except in the last sequence, a match: a 2 byte offset back
+// into the output and the match length. The high nibble of the token is the
+// number of literals and the low nibble the match length minus MIN_MATCH; 15 in
+// either means more length bytes follow, each adding up to 255.
+const std::size_t MIN_MATCH = 4;
+const int HASH_BITS = 12;
+
+void putLength(std::string& out, std::size_t length)
+{
+  while (length >= 255)
+  {
+    out.push_back((char) 255);
+    length -= 255;
+  }
+  out.push_back((char) length);
+}
+
+bool getLength(const unsigned char*& in, const unsigned char* end, std::size_t& length)
+{
+  unsigned char byte;
+  do
+  {
+    if (in == end)
+      return false;
+    byte = *in++;
+    length += byte;
+  } while (byte == 255);
+  return true;
+}
+
+void putSequence(std::string& out, const char* literals, const std::size_t literalLength,
+                 const std::size_t offset, const std::size_t matchLength)
+{
+  const std::size_t matchCode = matchLength == 0 ? 0 : matchLength - MIN_MATCH;
+  out.push_back((char) (((literalLength < 15 ? literalLength : 15) << 4) | (matchCode < 15 ? matchCode : 15)));
+  if (literalLength >= 15)
+    putLength(out, literalLength - 15);
+  out.append(literals, literalLength);
+  if (matchLength == 0)
+    return;
+  out.push_back((char) (offset & 0xff));
+  out.push_back((char) (offset >> 8));
+  if (matchCode >= 15)
+    putLength(out, matchCode - 15);
+}
+
+/**
+ * Compresses size bytes into out. Gives up, returning false, as soon as the output exceeds limit bytes.
+ */
+bool compress(const char* data, const std::size_t size, const std::size_t limit, std::string& out)
+{
+  std::int32_t table[1 << HASH_BITS];
+  for (int i = 0; i < (1 << HASH_BITS); i++)
+    table[i] = -1;
+
+  out.clear();
+  std::size_t anchor = 0;
+  std::size_t pos = 0;
+  while (pos + MIN_MATCH <= size)
+  {
+    std::uint32_t sequence;
+    std::memcpy(&sequence, data + pos, sizeof(sequence));
+    const std::uint32_t hash = (sequence * 2654435761u) >> (32 - HASH_BITS);
+    const std::int32_t candidate = table[hash];
+    table[hash] = pos;
+
+    if (candidate < 0 || pos - candidate > 0xffff || std::memcmp(data + candidate, &sequence, MIN_MATCH) != 0)
+    {
+      pos++;
+      continue;
+    }
+
+    std::size_t length = MIN_MATCH;
+    while (pos + length < size && data[candidate + length] == data[pos + length])
+      length++;
+    putSequence(out, data + anchor, pos - anchor, pos - candidate, length);
+    if (out.size() > limit)
+      return false;
+    pos += length;
+    anchor = pos;
+  }
+  putSequence(out, data + anchor, size - anchor, 0, 0);
+  return out.size() <= limit;
+}
+
+/**
+ * Decompresses exactly size bytes into data. Returns false if the input is not a valid compressed page.
+ */
+bool decompress(const std::string& compressed, char* data, const std::size_t size)
+{
+  const unsigned char* in = reinterpret_cast<const unsigned char*>(compressed.data());
+  const unsigned char* end = in + compressed.size();
+  std::size_t pos = 0;
+  while (in != end)
+  {
+    const unsigned char token = *in++;
+    std::size_t literalLength = token >> 4;
+    if (literalLength == 15 && !getLength(in, end, literalLength))
+      return false;
+    if (literalLength > (std::size_t) (end - in) || literalLength > size - pos)
+      return false;
+    std::memcpy(data + pos, in, literalLength);
+    in += literalLength;
+    pos += literalLength;
+    if (in == end)
+      break;
+
+    if (end - in < 2)
+      return false;
+    const std::size_t offset = in[0] | (in[1] << 8);
+    in += 2;
+    std::size_t matchLength = token & 0x0f;
+    if (matchLength == 15 && !getLength(in, end, matchLength))
+      return false;
+    matchLength += MIN_MATCH;
+    if (offset == 0 || offset > pos || matchLength > size - pos)
+      return false;
+
+    // byte by byte, since the match may overlap the bytes it produces
+    for (std::size_t i = 0; i < matchLength; i++, pos++)
+      data[pos] = data[pos - offset];
+  }
+  return pos == size;
+}
+
+}
+
+VictimCache::VictimCache(const std::size_t budget)
+	: budgetBytes(budget), usedBytes(0)
+{
+}
+
+void VictimCache::setBudget(const std::size_t budget)
+{
+  std::lock_guard<std::mutex> guard(mutex);
+  budgetBytes = budget;
+  trim();
+}
+
+std::size_t VictimCache::budget()
+{
+  std::lock_guard<std::mutex> guard(mutex);
+  return budgetBytes;
+}
+
+std::size_t VictimCache::used()
+{
+  std::lock_guard<std::mutex> guard(mutex);
+  return usedBytes;
+}
+
+std::size_t VictimCache::size()
+{
+  std::lock_guard<std::mutex> guard(mutex);
+  return entries.size();
+}
+
+std::size_t VictimCache::cost(const Entry& entry)
+{
+  // the compressed bytes plus, roughly, the list node and the index entry
+  return entry.data.capacity() + sizeof(Entry) + 4 * sizeof(void*) + sizeof(Key);
+}
+
+bool VictimCache::put(const File* file, const PageId pageNo, const Page& page)
+{
+  if (budget() == 0)
+    return false;
+
+  Entry entry;
+  entry.key = std::make_pair(file, pageNo);
+  const bool stored = compress(reinterpret_cast<const char*>(&page), sizeof(Page), MAX_STORED, entry.data);
+
+  std::lock_guard<std::mutex> guard(mutex);
+  std::unordered_map<Key, std::list<Entry>::iterator, KeyHash>::iterator old = index.find(entry.key);
+  if (old != index.end())
+    drop(old->second);
+  if (!stored || budgetBytes == 0)
+    return false;
+
+  entry.data.shrink_to_fit();
+  entry.charge = cost(entry);
+  usedBytes += entry.charge;
+  entries.push_front(Entry());
+  entries.front().key = entry.key;
+  entries.front().data.swap(entry.data);
+  entries.front().charge = entry.charge;
+  index[entries.front().key] = entries.begin();
+  trim();
+  return true;
+}
+
+bool VictimCache::take(const File* file, const PageId pageNo, Page& page)
+{
+  std::string data;
+  {
+    std::lock_guard<std::mutex> guard(mutex);
+    std::unordered_map<Key, std::list<Entry>::iterator, KeyHash>::iterator it = index.find(std::make_pair(file, pageNo));
+    if (it == index.end())
+      return false;
+    data.swap(it->second->data);
+    drop(it->second);
+  }
+  return decompress(data, reinterpret_cast<char*>(&page), sizeof(Page));
+}
+
+void VictimCache::erase(const File* file, const PageId pageNo)
+{
+  std::lock_guard<std::mutex> guard(mutex);
+  std::unordered_map<Key, std::list<Entry>::iterator, KeyHash>::iterator it = index.find(std::make_pair(file, pageNo));
+  if (it != index.end())
+    drop(it->second);
+}
+
+void VictimCache::eraseFile(const File* file)
+{
+  std::lock_guard<std::mutex> guard(mutex);
+  for (std::list<Entry>::iterator it = entries.begin(); it != entries.end(); )
+  {
+    std::list<Entry>::iterator next = it;
+    ++next;
+    if (it->key.first == file)
+      drop(it);
+    it = next;
+  }
+}
+
+void VictimCache::drop(const std::list<Entry>::iterator entry)
+{
+  usedBytes -= entry->charge;
+  index.erase(entry->key);
+  entries.erase(entry);
+}
+
+void VictimCache::trim()
+{
+  while (usedBytes > budgetBytes && !entries.empty())
+  {
+    std::list<Entry>::iterator oldest = entries.end();
+    --oldest;
+    drop(oldest);
+  }
+}
+
+}
@@ -0,0 +1,165 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+#include "file.h"
+#include "page.h"
+#include "types.h"
+
+namespace badgerdb {
+
+/**
+* @brief A bounded, in-memory second tier for pages evicted from the buffer pool, kept compressed.
+*
+* The buffer manager stores every page it evicts, once the page is clean, and looks here on a miss before going
+* to disk. Pages are compressed with a small LZ77 coder; slotted heap pages with short records and B+ tree nodes
+* with dense key arrays usually shrink to a fraction of Page::SIZE, so the cache covers several times as many
+* pages as the same memory would hold in frames. Pages that do not compress to at most MAX_STORED bytes are not
+* kept.
+*
+* Entries are dropped least recently stored first when the cache is over its budget. A page is never in the cache
+* and in the buffer pool at the same time: take() removes the entry it returns. All operations are thread safe;
+* compression and decompression run outside the cache's mutex.
+*/
+class VictimCache
+{
+ public:
+	/**
+   * Largest compressed size, in bytes, of a page worth keeping
+	 */
+  static const std::size_t MAX_STORED = Page::SIZE * 3 / 4;
+
+	/**
+   * Constructs a cache. A budget of 0 keeps it disabled.
+   *
+   * @param budget	Memory the cache may use, in bytes, counting the compressed pages and the bookkeeping
+   *                for each of them
+	 */
+  VictimCache(const std::size_t budget);
+
+	/**
+   * Changes the memory budget, dropping entries if the cache is now over it. 0 disables the cache and empties it.
+	 */
+  void setBudget(const std::size_t budget);
+
+	/**
+   * Returns the memory the cache may use, in bytes
+	 */
+  std::size_t budget();
+
+	/**
+   * Returns the memory the cache uses now, in bytes
+	 */
+  std::size_t used();
+
+	/**
+   * Returns the number of pages in the cache
+	 */
+  std::size_t size();
+
+	/**
+   * Stores a page, replacing any older copy of it. The page must be the same as its copy on disk.
+   *
+   * @param file		File the page belongs to
+   * @param pageNo	Number of the page
+   * @param page		The page
+   * @return  False if the page was not stored, because the cache is disabled or the page does not compress well
+	 */
+  bool put(const File* file, const PageId pageNo, const Page& page);
+
+	/**
+   * Removes a page from the cache and returns it.
+   *
+   * @param file		File the page belongs to
+   * @param pageNo	Number of the page
+   * @param page		Receives the page, if it was in the cache
+   * @return  False if the page was not in the cache
+	 */
+  bool take(const File* file, const PageId pageNo, Page& page);
+
+	/**
+   * Drops a page, if it is in the cache.
+	 */
+  void erase(const File* file, const PageId pageNo);
+
+	/**
+   * Drops all pages of a file.
+	 */
+  void eraseFile(const File* file);
+
+ private:
+  typedef std::pair<const File*, PageId> Key;
+
+	/**
+   * Hash of a (file, page) key
+	 */
+  struct KeyHash
+  {
+    std::size_t operator()(const Key& key) const
+    {
+      return std::hash<const File*>()(key.first) * 31 + key.second;
+    }
+  };
+
+	/**
+   * A cached page
+	 */
+  struct Entry
+  {
+    Key key;
+    std::string data;		/* the compressed page */
+    std::size_t charge;	/* bytes counted against the budget */
+  };
+
+	/**
+   * Bytes to charge a new entry against the budget
+	 */
+  static std::size_t cost(const Entry& entry);
+
+	/**
+   * Removes an entry. The caller holds the mutex.
+	 */
+  void drop(const std::list<Entry>::iterator entry);
+
+	/**
+   * Drops the oldest entries until the cache is within its budget. The caller holds the mutex.
+	 */
+  void trim();
+
+	/**
+   * Entries, most recently stored first
+	 */
+  std::list<Entry> entries;
+
+	/**
+   * Entries by file and page number
+	 */
+  std::unordered_map<Key, std::list<Entry>::iterator, KeyHash> index;
+
+	/**
+   * Memory budget and memory in use, in bytes
+	 */
+  std::size_t budgetBytes;
+  std::size_t usedBytes;
+
+	/**
+   * Protects all of the above
+	 */
+  std::mutex mutex;
+};
+
+}